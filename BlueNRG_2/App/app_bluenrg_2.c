@@ -77,6 +77,40 @@ uint8_t counter      = 0;
 uint8_t local_name[] = { AD_TYPE_COMPLETE_LOCAL_NAME, 'B', 'l', 'u', 'e', 'N', 'R', 'G', '_', 'S', 'a', 'm', 'p', 'l', 'e', 'A', 'p', 'p' };
 
 /* USER CODE BEGIN PV */
+/* Outbound notification queue, one ring per priority */
+#define NOTIFY_QUEUE_LENGTH 8
+#define NOTIFY_MAX_LENGTH   CHAR_VALUE_LENGTH
+
+typedef struct notifyEntry_s
+{
+	uint8_t channel;
+	uint8_t length;
+	uint8_t data[NOTIFY_MAX_LENGTH];
+} notifyEntry_t;
+
+typedef struct notifyQueue_s
+{
+	notifyEntry_t entries[NOTIFY_QUEUE_LENGTH];
+	uint8_t head;
+	uint8_t count;
+} notifyQueue_t;
+
+typedef struct notifyChannelConfig_s
+{
+	BLE_NotifyPriority_t priority;
+	BLE_NotifyDropPolicy_t policy;
+} notifyChannelConfig_t;
+
+static const notifyChannelConfig_t notify_channel_config[BLE_NOTIFY_CHANNEL_COUNT] = {
+	[BLE_NOTIFY_SAMPLE]        = { BLE_NOTIFY_PRIORITY_LOW, BLE_NOTIFY_DROP_NEWEST },
+	[BLE_NOTIFY_TRIANGLE_MESH] = { BLE_NOTIFY_PRIORITY_HIGH, BLE_NOTIFY_DROP_NEWEST },
+	[BLE_NOTIFY_TRANSFORM]     = { BLE_NOTIFY_PRIORITY_HIGH, BLE_NOTIFY_DROP_OLDEST },
+	[BLE_NOTIFY_TELEMETRY]     = { BLE_NOTIFY_PRIORITY_LOW, BLE_NOTIFY_DROP_REPLACE },
+	[BLE_NOTIFY_DIAGNOSTICS]   = { BLE_NOTIFY_PRIORITY_LOW, BLE_NOTIFY_DROP_NEWEST },
+};
+
+static notifyQueue_t notify_queues[BLE_NOTIFY_PRIORITY_COUNT];
+static BLE_NotifyStats_t notify_stats;
 
 /* USER CODE END PV */
 
@@ -91,6 +125,195 @@ static uint8_t Find_DeviceName(uint8_t data_length, uint8_t* data_value);
 static void Attribute_Modified_CB(uint16_t handle, uint8_t data_length, uint8_t* att_data);
 
 /* USER CODE BEGIN PFP */
+static void Notify_Flush(void);
+static void Notify_Drain(void);
+
+/**
+ * @brief  Get the characteristic a notification channel is sent on.
+ * @param  channel : notification channel
+ * @param  service_handle : returned service handle
+ * @param  char_handle : returned characteristic handle
+ * @retval None
+ */
+static void Notify_GetHandles(BLE_NotifyChannel_t channel, uint16_t* service_handle, uint16_t* char_handle)
+{
+	switch (channel)
+	{
+	case BLE_NOTIFY_TRIANGLE_MESH:
+		*service_handle = TrianglemeshServHandle;
+		*char_handle    = TrianglemeshTxCharHandle;
+		break;
+	case BLE_NOTIFY_TRANSFORM:
+	case BLE_NOTIFY_TELEMETRY:
+	case BLE_NOTIFY_DIAGNOSTICS:
+		*service_handle = TransformServHandle;
+		*char_handle    = TransformTxCharHandle;
+		break;
+	default:
+		*service_handle = sampleServHandle;
+		*char_handle    = sampleTXCharHandle;
+		break;
+	}
+}
+
+/**
+ * @brief  Remove all pending notifications.
+ * @param  None
+ * @retval None
+ */
+static void Notify_Flush(void)
+{
+	for (uint8_t i = 0; i < BLE_NOTIFY_PRIORITY_COUNT; i++)
+	{
+		notify_queues[i].head  = 0;
+		notify_queues[i].count = 0;
+	}
+}
+
+/**
+ * @brief  Send pending notifications, highest priority first, until the queue
+ *         is empty or the radio TX pool is full. Never waits on the radio.
+ * @param  None
+ * @retval None
+ */
+static void Notify_Drain(void)
+{
+	/* Notifications still pending when the connection dropped are discarded */
+	if (!APP_FLAG(CONNECTED))
+	{
+		Notify_Flush();
+		return;
+	}
+
+	for (int8_t priority = BLE_NOTIFY_PRIORITY_COUNT - 1; priority >= 0; priority--)
+	{
+		notifyQueue_t* queue = &notify_queues[priority];
+
+		while (queue->count > 0)
+		{
+			if (APP_FLAG(TX_BUFFER_FULL))
+				return;
+
+			notifyEntry_t* entry = &queue->entries[queue->head];
+			tBleStatus ret;
+
+			if (device_role == SLAVE_ROLE)
+			{
+				uint16_t service_handle, char_handle;
+				Notify_GetHandles((BLE_NotifyChannel_t)entry->channel, &service_handle, &char_handle);
+
+				ret = aci_gatt_update_char_value_ext(connection_handle, service_handle, char_handle,
+				                                     1, entry->length, 0, entry->length, entry->data);
+				if (ret == BLE_STATUS_INSUFFICIENT_RESOURCES)
+				{
+					/* Retried once aci_gatt_tx_pool_available_event clears the flag */
+					APP_FLAG_SET(TX_BUFFER_FULL);
+					return;
+				}
+			}
+			else
+			{
+				ret = aci_gatt_write_without_resp(connection_handle, rx_handle + 1, entry->length, entry->data);
+				if (ret == BLE_STATUS_NOT_ALLOWED)
+					return; /* Radio busy, retried on the next pass */
+			}
+
+			if (ret == BLE_STATUS_SUCCESS)
+				notify_stats.sent++;
+			else
+				notify_stats.failed++;
+
+			queue->head = (queue->head + 1) % NOTIFY_QUEUE_LENGTH;
+			queue->count--;
+		}
+	}
+}
+
+/**
+ * @brief  Queue a notification to be sent without blocking. The channel's
+ *         drop policy decides what happens when its priority queue is full.
+ * @param  channel : notification channel
+ * @param  data_buffer : pointer to data to be sent
+ * @param  Nb_bytes : number of bytes to send
+ * @retval TRUE if the notification was queued, FALSE if it was dropped
+ */
+uint8_t BLE_Notify(BLE_NotifyChannel_t channel, const uint8_t* data_buffer, uint8_t Nb_bytes)
+{
+	if (channel >= BLE_NOTIFY_CHANNEL_COUNT || Nb_bytes > NOTIFY_MAX_LENGTH || !APP_FLAG(CONNECTED))
+	{
+		notify_stats.dropped++;
+		return FALSE;
+	}
+
+	const notifyChannelConfig_t* config = &notify_channel_config[channel];
+	notifyQueue_t* queue                = &notify_queues[config->priority];
+	notifyEntry_t* entry                = NULL;
+
+	if (config->policy == BLE_NOTIFY_DROP_REPLACE)
+	{
+		/* Only the latest value matters, overwrite a pending one in place */
+		for (uint8_t i = 0; i < queue->count; i++)
+		{
+			notifyEntry_t* pending = &queue->entries[(queue->head + i) % NOTIFY_QUEUE_LENGTH];
+			if (pending->channel == channel)
+			{
+				entry = pending;
+				break;
+			}
+		}
+	}
+
+	if (entry == NULL)
+	{
+		if (queue->count == NOTIFY_QUEUE_LENGTH)
+		{
+			notify_stats.dropped++;
+
+			if (config->policy == BLE_NOTIFY_DROP_NEWEST)
+				return FALSE;
+
+			/* Drop the oldest entry to make room */
+			queue->head = (queue->head + 1) % NOTIFY_QUEUE_LENGTH;
+			queue->count--;
+		}
+
+		entry = &queue->entries[(queue->head + queue->count) % NOTIFY_QUEUE_LENGTH];
+		queue->count++;
+	}
+
+	entry->channel = channel;
+	entry->length  = Nb_bytes;
+	BLUENRG_memcpy(entry->data, data_buffer, Nb_bytes);
+
+	if (queue->count > notify_stats.high_water)
+		notify_stats.high_water = queue->count;
+
+	return TRUE;
+}
+
+/**
+ * @brief  Get the number of notifications waiting to be sent.
+ * @param  None
+ * @retval Queue depth
+ */
+uint8_t BLE_GetNotifyQueueDepth(void)
+{
+	uint8_t depth = 0;
+	for (uint8_t i = 0; i < BLE_NOTIFY_PRIORITY_COUNT; i++)
+		depth += notify_queues[i].count;
+
+	return depth;
+}
+
+/**
+ * @brief  Get the notification queue statistics.
+ * @param  None
+ * @retval Pointer to the statistics
+ */
+const BLE_NotifyStats_t* BLE_GetNotifyStats(void)
+{
+	return &notify_stats;
+}
 
 /* USER CODE END PFP */
 
@@ -157,110 +380,13 @@ void MX_BlueNRG_2_Process(void)
 	User_Process();
 
 	/* USER CODE BEGIN BlueNRG_2_Process_PostTreatment */
+	/* Restart an HCI read deferred while the packet pool was empty, then send the queued notifications */
+	hci_tl_lowlevel_resume();
+	Notify_Drain();
 
 	/* USER CODE END BlueNRG_2_Process_PostTreatment */
 }
 
-static void sendTransformData(uint8_t* data_buffer, uint8_t Nb_bytes)
-{
-	uint32_t tickstart = HAL_GetTick();
-	if (device_role == SLAVE_ROLE)
-	{
-		while (aci_gatt_update_char_value_ext(connection_handle,
-		                                      TransformServHandle,
-		                                      TransformTxCharHandle,
-		                                      1, Nb_bytes, 0, Nb_bytes, data_buffer) == BLE_STATUS_INSUFFICIENT_RESOURCES)
-		{
-			APP_FLAG_SET(TX_BUFFER_FULL);
-			while (APP_FLAG(TX_BUFFER_FULL)) {
-				hci_user_evt_proc();
-				// Radio is busy (buffer full).
-				if ((HAL_GetTick() - tickstart) > (10 * HCI_DEFAULT_TIMEOUT_MS))
-					break;
-			}
-		}
-	}
-	else
-	{
-		while (aci_gatt_write_without_resp(connection_handle, rx_handle + 1, Nb_bytes, data_buffer) == BLE_STATUS_NOT_ALLOWED)
-		{
-			hci_user_evt_proc();
-			// Radio is busy (buffer full).
-			if ((HAL_GetTick() - tickstart) > (10 * HCI_DEFAULT_TIMEOUT_MS))
-				break;
-		}
-	}
-}
-static void sendTriangleMeshData(uint8_t* data_buffer, uint8_t Nb_bytes)
-{
-	uint32_t tickstart = HAL_GetTick();
-	if (device_role == SLAVE_ROLE)
-	{
-		while (aci_gatt_update_char_value_ext(connection_handle,
-		                                      TrianglemeshServHandle,
-		                                      TrianglemeshTxCharHandle,
-		                                      1, Nb_bytes, 0, Nb_bytes, data_buffer) == BLE_STATUS_INSUFFICIENT_RESOURCES)
-		{
-			APP_FLAG_SET(TX_BUFFER_FULL);
-			while (APP_FLAG(TX_BUFFER_FULL)) {
-				hci_user_evt_proc();
-				// Radio is busy (buffer full).
-				if ((HAL_GetTick() - tickstart) > (10 * HCI_DEFAULT_TIMEOUT_MS))
-					break;
-			}
-		}
-	}
-	else
-	{
-		while (aci_gatt_write_without_resp(connection_handle, rx_handle + 1, Nb_bytes, data_buffer) == BLE_STATUS_NOT_ALLOWED)
-		{
-			hci_user_evt_proc();
-			// Radio is busy (buffer full).
-			if ((HAL_GetTick() - tickstart) > (10 * HCI_DEFAULT_TIMEOUT_MS))
-				break;
-		}
-	}
-}
-
-/**
- * @brief  This function is used to send data related to the sample service
- *         (to be sent over the air to the remote board).
- * @param  data_buffer : pointer to data to be sent
- * @param  Nb_bytes : number of bytes to send
- * @retval None
- */
-static void sendData(uint8_t* data_buffer, uint8_t Nb_bytes)
-{
-	uint32_t tickstart = HAL_GetTick();
-
-	if (device_role == SLAVE_ROLE)
-	{
-		while (aci_gatt_update_char_value_ext(connection_handle,
-		                                      sampleServHandle,
-		                                      sampleTXCharHandle,
-		                                      1, Nb_bytes, 0, Nb_bytes, data_buffer) == BLE_STATUS_INSUFFICIENT_RESOURCES)
-		{
-			APP_FLAG_SET(TX_BUFFER_FULL);
-			while (APP_FLAG(TX_BUFFER_FULL)) {
-				hci_user_evt_proc();
-				// Radio is busy (buffer full).
-				if ((HAL_GetTick() - tickstart) > (10 * HCI_DEFAULT_TIMEOUT_MS))
-					break;
-			}
-		}
-	}
-	else
-	{
-		while (aci_gatt_write_without_resp(connection_handle, rx_handle + 1, Nb_bytes, data_buffer) == BLE_STATUS_NOT_ALLOWED)
-		{
-			hci_user_evt_proc();
-			// Radio is busy (buffer full).
-			if ((HAL_GetTick() - tickstart) > (10 * HCI_DEFAULT_TIMEOUT_MS))
-				break;
-		}
-	}
-}
-
 /**
  * @brief  This function is used to receive data related to the sample service
  *         (received over the air from the remote board).
@@ -34,6 +34,49 @@
 /* Exported Defines ----------------------------------------------------------*/
 
 /* USER CODE BEGIN ED */
+/**
+  * @brief  Outbound notification channels
+  */
+typedef enum
+{
+  BLE_NOTIFY_SAMPLE = 0,
+  BLE_NOTIFY_TRIANGLE_MESH,
+  BLE_NOTIFY_TRANSFORM,
+  BLE_NOTIFY_TELEMETRY,
+  BLE_NOTIFY_DIAGNOSTICS,
+  BLE_NOTIFY_CHANNEL_COUNT
+} BLE_NotifyChannel_t;
+
+/**
+  * @brief  Notification priorities, higher priorities are sent first
+  */
+typedef enum
+{
+  BLE_NOTIFY_PRIORITY_LOW = 0,
+  BLE_NOTIFY_PRIORITY_HIGH,
+  BLE_NOTIFY_PRIORITY_COUNT
+} BLE_NotifyPriority_t;
+
+/**
+  * @brief  What to do with a notification when its priority queue is full
+  */
+typedef enum
+{
+  BLE_NOTIFY_DROP_NEWEST = 0, /* Drop the notification being queued */
+  BLE_NOTIFY_DROP_OLDEST,     /* Drop the oldest pending notification */
+  BLE_NOTIFY_DROP_REPLACE     /* Overwrite a pending notification of the same channel */
+} BLE_NotifyDropPolicy_t;
+
+/**
+  * @brief  Outbound notification queue statistics
+  */
+typedef struct
+{
+  uint32_t sent;
+  uint32_t failed;
+  uint32_t dropped;
+  uint8_t high_water;
+} BLE_NotifyStats_t;
 
 /* USER CODE END ED */
 
@@ -48,6 +91,9 @@ void MX_BlueNRG_2_Init(void);
 void MX_BlueNRG_2_Process(void);
 
 /* USER CODE BEGIN EFP */
+uint8_t BLE_Notify(BLE_NotifyChannel_t channel, const uint8_t* data_buffer, uint8_t Nb_bytes);
+uint8_t BLE_GetNotifyQueueDepth(void);
+const BLE_NotifyStats_t* BLE_GetNotifyStats(void);
 
 /* USER CODE END EFP */
 
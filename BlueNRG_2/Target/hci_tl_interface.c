@@ -21,6 +21,8 @@
 #include "RTE_Components.h"
 
 #include "hci_tl.h"
+#include "critical_section.h"
+#include "memory_regions.h"
 
 /* Defines -------------------------------------------------------------------*/
 
@@ -28,14 +30,56 @@
 #define MAX_BUFFER_SIZE   255U
 #define TIMEOUT_DURATION  100U
 #define TIMEOUT_IRQ_HIGH  1000U
+/* Ticks after which a read is released even though the BlueNRG never lowered the IRQ line */
+#define TIMEOUT_IRQ_LOW   2U
+
+/* Private types -------------------------------------------------------------*/
+
+/**
+ * @brief  State of the DMA driven SPI transport
+ */
+typedef enum
+{
+  HCI_TL_SPI_IDLE = 0,   /* No transfer in progress */
+  HCI_TL_SPI_RX_HEADER,  /* Reading the header of an event */
+  HCI_TL_SPI_RX_PAYLOAD, /* Reading the payload of an event */
+  HCI_TL_SPI_RX_RELEASE, /* Waiting with CS low for the IRQ line to fall after a read */
+  HCI_TL_SPI_TX,         /* Writing a command */
+} HCI_TL_SPI_State_t;
 
 /* Private variables ---------------------------------------------------------*/
 EXTI_HandleTypeDef hexti4;
+DMA_HandleTypeDef hdma_spi1_rx;
+DMA_HandleTypeDef hdma_spi1_tx;
+
+extern SPI_HandleTypeDef hspi1;
+
+static volatile HCI_TL_SPI_State_t spi_state = HCI_TL_SPI_IDLE;
+static volatile uint8_t send_active          = 0;
+static volatile uint8_t dma_ready            = 0;
+static volatile uint8_t rx_deferred          = 0;
+static tHciDataPacket* volatile rx_packet    = NULL;
+static volatile uint32_t release_tick        = 0;
+
+/* DMA cannot reach the DTCM stack, so transfers go through these non-cacheable buffers in D2 SRAM.
+ * Event payloads are read straight into HCI pool packets, which live in the same section. */
+static uint8_t dma_header_tx[CACHE_LINE_PAD(HEADER_SIZE)] DMA_BUFFER_D2;
+static uint8_t dma_header_rx[CACHE_LINE_PAD(HEADER_SIZE)] DMA_BUFFER_D2;
+static uint8_t dma_dummy_tx[CACHE_LINE_PAD(HCI_READ_PACKET_SIZE)] DMA_BUFFER_D2;
+static uint8_t dma_tx_buffer[CACHE_LINE_PAD(MAX_BUFFER_SIZE)] DMA_BUFFER_D2;
 
 /* Private function prototypes -----------------------------------------------*/
 static void HCI_TL_SPI_Enable_IRQ(void);
 static void HCI_TL_SPI_Disable_IRQ(void);
 static int32_t IsDataAvailable(void);
+static int32_t HCI_TL_SPI_DMA_Init(void);
+static void HCI_TL_SPI_StartReceive(void);
+static void HCI_TL_SPI_DropPacket(void);
+static void HCI_TL_SPI_WaitIrqLow(void);
+static void HCI_TL_SPI_PollIrqLow(void);
+static void HCI_TL_SPI_Release(void);
+static void HCI_TL_SPI_TransferComplete(SPI_HandleTypeDef* hspi);
+static void HCI_TL_SPI_TransferError(SPI_HandleTypeDef* hspi);
 
 /******************** IO Operation and BUS services ***************************/
 /**
@@ -93,7 +137,85 @@ int32_t HCI_TL_SPI_Init(void* pConf)
   /* Deselect CS PIN for BlueNRG at startup to avoid spurious commands */
   HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
 
-  return BSP_SPI1_Init();
+  int32_t ret = BSP_SPI1_Init();
+  if (ret != BSP_ERROR_NONE)
+  {
+    return ret;
+  }
+
+  return HCI_TL_SPI_DMA_Init();
+}
+
+/**
+ * @brief  Configures the DMA streams and completion callbacks of SPI1
+ *
+ * @param  None
+ * @retval int32_t Status
+ */
+static int32_t HCI_TL_SPI_DMA_Init(void)
+{
+  __HAL_RCC_DMA1_CLK_ENABLE();
+
+  hdma_spi1_rx.Instance                 = DMA1_Stream0;
+  hdma_spi1_rx.Init.Request             = DMA_REQUEST_SPI1_RX;
+  hdma_spi1_rx.Init.Direction           = DMA_PERIPH_TO_MEMORY;
+  hdma_spi1_rx.Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma_spi1_rx.Init.MemInc              = DMA_MINC_ENABLE;
+  hdma_spi1_rx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_spi1_rx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma_spi1_rx.Init.Mode                = DMA_NORMAL;
+  hdma_spi1_rx.Init.Priority            = DMA_PRIORITY_HIGH;
+  hdma_spi1_rx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(&hdma_spi1_rx) != HAL_OK)
+  {
+    return BSP_ERROR_PERIPH_FAILURE;
+  }
+  __HAL_LINKDMA(&hspi1, hdmarx, hdma_spi1_rx);
+
+  hdma_spi1_tx.Instance                 = DMA1_Stream1;
+  hdma_spi1_tx.Init.Request             = DMA_REQUEST_SPI1_TX;
+  hdma_spi1_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+  hdma_spi1_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+  hdma_spi1_tx.Init.MemInc              = DMA_MINC_ENABLE;
+  hdma_spi1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+  hdma_spi1_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+  hdma_spi1_tx.Init.Mode                = DMA_NORMAL;
+  hdma_spi1_tx.Init.Priority            = DMA_PRIORITY_HIGH;
+  hdma_spi1_tx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+  if (HAL_DMA_Init(&hdma_spi1_tx) != HAL_OK)
+  {
+    return BSP_ERROR_PERIPH_FAILURE;
+  }
+  __HAL_LINKDMA(&hspi1, hdmatx, hdma_spi1_tx);
+
+  /* Single data FIFO threshold so every byte raises a DMA request, whatever the transfer length */
+  hspi1.Init.FifoThreshold = SPI_FIFO_THRESHOLD_01DATA;
+  if (HAL_SPI_Init(&hspi1) != HAL_OK)
+  {
+    return BSP_ERROR_BUS_FAILURE;
+  }
+
+  if (HAL_SPI_RegisterCallback(&hspi1, HAL_SPI_TX_RX_COMPLETE_CB_ID, HCI_TL_SPI_TransferComplete) != HAL_OK ||
+      HAL_SPI_RegisterCallback(&hspi1, HAL_SPI_TX_COMPLETE_CB_ID, HCI_TL_SPI_TransferComplete) != HAL_OK ||
+      HAL_SPI_RegisterCallback(&hspi1, HAL_SPI_ERROR_CB_ID, HCI_TL_SPI_TransferError) != HAL_OK)
+  {
+    return BSP_ERROR_PERIPH_FAILURE;
+  }
+
+  /* The header request is constant, the D2 SRAM buffers are zero filled at startup so it is written here */
+  dma_header_tx[0] = 0x0b;
+
+  /* Same priority as the EXTI line so the transfer state machine is never preempted by itself */
+  HAL_NVIC_SetPriority(DMA1_Stream0_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream0_IRQn);
+  HAL_NVIC_SetPriority(DMA1_Stream1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(DMA1_Stream1_IRQn);
+  HAL_NVIC_SetPriority(SPI1_IRQn, 0, 0);
+  HAL_NVIC_EnableIRQ(SPI1_IRQn);
+
+  dma_ready = 1;
+
+  return BSP_ERROR_NONE;
 }
 
 /**
@@ -131,6 +253,8 @@ int32_t HCI_TL_SPI_Reset(void)
 
 /**
  * @brief  Reads from BlueNRG SPI buffer and store data into local buffer.
+ *         Events are read by DMA directly into HCI pool packets and handed to
+ *         hci_notify_asynch_evt(), so there is never anything to read here.
  *
  * @param  buffer : Buffer where data from SPI are stored
  * @param  size   : Buffer size
@@ -138,62 +262,17 @@ int32_t HCI_TL_SPI_Reset(void)
  */
 int32_t HCI_TL_SPI_Receive(uint8_t* buffer, uint16_t size)
 {
-  uint16_t byte_count;
-  uint8_t len = 0;
-  uint8_t char_00 = 0x00;
-  volatile uint8_t read_char;
-
-  uint8_t header_master[HEADER_SIZE] = {0x0b, 0x00, 0x00, 0x00, 0x00};
-  uint8_t header_slave[HEADER_SIZE];
-
-  HCI_TL_SPI_Disable_IRQ();
-
-  /* CS reset */
-  HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_RESET);
-
-  /* Read the header */
-  BSP_SPI1_SendRecv(header_master, header_slave, HEADER_SIZE);
-
-  /* device is ready */
-  byte_count = (header_slave[4] << 8)| header_slave[3];
-
-  if(byte_count > 0)
-  {
-
-    /* avoid to read more data than the size of the buffer */
-    if (byte_count > size)
-    {
-      byte_count = size;
-    }
-
-    for(len = 0; len < byte_count; len++)
-    {
-      BSP_SPI1_SendRecv(&char_00, (uint8_t*)&read_char, 1);
-      buffer[len] = read_char;
-    }
-  }
+  (void)buffer;
+  (void)size;
 
-  /**
-   * To be aligned to the SPI protocol.
-   * Can bring to a delay inside the frame, due to the BlueNRG-2 that needs
-   * to check if the header is received or not.
-   */
-  uint32_t tickstart = HAL_GetTick();
-  while ((HAL_GetTick() - tickstart) < TIMEOUT_IRQ_HIGH) {
-    if (HAL_GPIO_ReadPin(HCI_TL_SPI_IRQ_PORT, HCI_TL_SPI_IRQ_PIN)==GPIO_PIN_RESET) {
-      break;
-    }
-  }
-  HCI_TL_SPI_Enable_IRQ();
-
-  /* Release CS line */
-  HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
-
-  return len;
+  return 0;
 }
 
 /**
  * @brief  Writes data from local buffer to SPI.
+ *         Waits for an in-flight DMA read to finish, then sends the command
+ *         through DMA. The caller is blocked until the command is written since
+ *         hci_send_req() needs the response before returning.
  *
  * @param  buffer : data buffer to be written
  * @param  size   : size of first data buffer to be written
@@ -207,11 +286,32 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
   uint8_t header_master[HEADER_SIZE] = {0x0a, 0x00, 0x00, 0x00, 0x00};
   uint8_t header_slave[HEADER_SIZE];
 
-  static uint8_t read_char_buf[MAX_BUFFER_SIZE];
   uint32_t tickstart = HAL_GetTick();
 
+  if (size > MAX_BUFFER_SIZE)
+  {
+    return -2;
+  }
+
+  send_active = 1;
   HCI_TL_SPI_Disable_IRQ();
 
+  /* Let an in-flight read finish, no new one starts while send_active is set.
+   * The EXTI line is masked, so the falling edge that releases a read is polled for. */
+  while (spi_state != HCI_TL_SPI_IDLE)
+  {
+    HCI_TL_SPI_PollIrqLow();
+
+    if ((HAL_GetTick() - tickstart) > TIMEOUT_DURATION)
+    {
+      send_active = 0;
+      HCI_TL_SPI_Enable_IRQ();
+      return -3;
+    }
+  }
+
+  BLUENRG_memcpy(dma_tx_buffer, buffer, size);
+
   do
   {
     uint32_t tickstart_data_available = HAL_GetTick();
@@ -248,7 +348,22 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
     if(rx_bytes >= size)
     {
       /* Buffer is big enough */
-      BSP_SPI1_SendRecv(buffer, read_char_buf, size);
+      spi_state = HCI_TL_SPI_TX;
+      if (HAL_SPI_Transmit_DMA(&hspi1, dma_tx_buffer, size) != HAL_OK)
+      {
+        spi_state = HCI_TL_SPI_IDLE;
+        result    = -1;
+      }
+
+      while (spi_state == HCI_TL_SPI_TX)
+      {
+        if ((HAL_GetTick() - tickstart) > TIMEOUT_DURATION)
+        {
+          HAL_SPI_Abort(&hspi1);
+          spi_state = HCI_TL_SPI_IDLE;
+          result    = -3;
+        }
+      }
     }
     else
     {
@@ -277,11 +392,223 @@ int32_t HCI_TL_SPI_Send(uint8_t* buffer, uint16_t size)
       break;
     }
   }
+
+  send_active = 0;
   HCI_TL_SPI_Enable_IRQ();
 
+  /* An event may have been raised while the IRQ was masked */
+  HCI_TL_SPI_StartReceive();
+
   return result;
 }
 
+/**
+ * @brief  Starts a DMA read of the event header if the BlueNRG has data,
+ *         the transport is idle and the HCI layer has a free packet.
+ *
+ * @param  None
+ * @retval None
+ */
+static void HCI_TL_SPI_StartReceive(void)
+{
+  uint32_t primask = EnterCriticalSection();
+
+  if (!dma_ready || send_active || spi_state != HCI_TL_SPI_IDLE || !IsDataAvailable())
+  {
+    ExitCriticalSection(primask);
+    return;
+  }
+
+  /* Only retry the allocation once the application has released a packet */
+  if (rx_deferred && hci_packet_pool_free() == 0)
+  {
+    ExitCriticalSection(primask);
+    return;
+  }
+
+  rx_packet   = hci_packet_alloc();
+  rx_deferred = rx_packet == NULL;
+  if (rx_deferred)
+  {
+    ExitCriticalSection(primask);
+    return;
+  }
+
+  spi_state = HCI_TL_SPI_RX_HEADER;
+  ExitCriticalSection(primask);
+
+  /* CS reset */
+  HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_RESET);
+
+  if (HAL_SPI_TransmitReceive_DMA(&hspi1, dma_header_tx, dma_header_rx, HEADER_SIZE) != HAL_OK)
+  {
+    HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
+    HCI_TL_SPI_DropPacket();
+  }
+}
+
+/**
+ * @brief  Returns the packet of an aborted read to the pool.
+ *
+ * @param  None
+ * @retval None
+ */
+static void HCI_TL_SPI_DropPacket(void)
+{
+  tHciDataPacket* packet = rx_packet;
+
+  rx_packet = NULL;
+  spi_state = HCI_TL_SPI_IDLE;
+
+  if (packet != NULL)
+  {
+    hci_packet_release(packet);
+  }
+}
+
+/**
+ * @brief  Keeps CS low after a read until the BlueNRG lowers the IRQ line, as
+ *         the blocking transport did, so the line still high from the event
+ *         just read is not taken for the next one. Rather than spinning in the
+ *         interrupt, the EXTI line is switched to the falling edge and the read
+ *         is released from hci_tl_lowlevel_isr().
+ *
+ * @param  None
+ * @retval None
+ */
+static void HCI_TL_SPI_WaitIrqLow(void)
+{
+  release_tick = HAL_GetTick();
+  spi_state    = HCI_TL_SPI_RX_RELEASE;
+
+  EXTI->RTSR1 &= ~HCI_TL_SPI_EXTI_PIN;
+  EXTI->FTSR1 |= HCI_TL_SPI_EXTI_PIN;
+
+  /* The line may have fallen before the edge was armed */
+  HCI_TL_SPI_PollIrqLow();
+}
+
+/**
+ * @brief  Releases a read waiting for the IRQ line once it is low, or once the
+ *         BlueNRG failed to lower it in time.
+ *
+ * @param  None
+ * @retval None
+ */
+static void HCI_TL_SPI_PollIrqLow(void)
+{
+  uint32_t primask = EnterCriticalSection();
+
+  if (spi_state == HCI_TL_SPI_RX_RELEASE &&
+      (HAL_GPIO_ReadPin(HCI_TL_SPI_IRQ_PORT, HCI_TL_SPI_IRQ_PIN) == GPIO_PIN_RESET ||
+       (HAL_GetTick() - release_tick) > TIMEOUT_IRQ_LOW))
+  {
+    HCI_TL_SPI_Release();
+  }
+
+  ExitCriticalSection(primask);
+}
+
+/**
+ * @brief  Ends a read whose IRQ line fell, hands its packet to the HCI layer
+ *         and re-arms the EXTI line on the rising edge of the next event.
+ *
+ * @param  None
+ * @retval None
+ */
+static void HCI_TL_SPI_Release(void)
+{
+  tHciDataPacket* packet = rx_packet;
+
+  EXTI->FTSR1 &= ~HCI_TL_SPI_EXTI_PIN;
+  EXTI->RTSR1 |= HCI_TL_SPI_EXTI_PIN;
+  __HAL_GPIO_EXTI_CLEAR_IT(HCI_TL_SPI_EXTI_PIN);
+
+  /* Release CS line */
+  HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
+
+  if (packet->data_len == 0)
+  {
+    HCI_TL_SPI_DropPacket();
+  }
+  else
+  {
+    /* Hand the packet over without copying, the HCI layer now owns the reference */
+    rx_packet = NULL;
+    spi_state = HCI_TL_SPI_IDLE;
+    hci_notify_asynch_evt(packet);
+  }
+
+  /* No rising edge is seen if the next event is already pending */
+  HCI_TL_SPI_StartReceive();
+}
+
+/**
+ * @brief  SPI1 DMA transfer complete callback, advances the transfer state machine.
+ *
+ * @param  hspi : SPI handle
+ * @retval None
+ */
+static void HCI_TL_SPI_TransferComplete(SPI_HandleTypeDef* hspi)
+{
+  switch (spi_state)
+  {
+  case HCI_TL_SPI_RX_HEADER:
+  {
+    /* device is ready */
+    uint16_t byte_count = (dma_header_rx[4] << 8) | dma_header_rx[3];
+
+    if (byte_count == 0)
+    {
+      /* Nothing to read, the packet is dropped once the IRQ line fell */
+      rx_packet->data_len = 0;
+      HCI_TL_SPI_WaitIrqLow();
+      break;
+    }
+
+    /* avoid to read more data than the size of the buffer */
+    if (byte_count > HCI_READ_PACKET_SIZE)
+    {
+      byte_count = HCI_READ_PACKET_SIZE;
+    }
+
+    rx_packet->data_len = (uint8_t)byte_count;
+    spi_state           = HCI_TL_SPI_RX_PAYLOAD;
+
+    if (HAL_SPI_TransmitReceive_DMA(hspi, dma_dummy_tx, rx_packet->dataBuff, byte_count) != HAL_OK)
+    {
+      HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
+      HCI_TL_SPI_DropPacket();
+    }
+  }
+  break;
+  case HCI_TL_SPI_RX_PAYLOAD:
+    HCI_TL_SPI_WaitIrqLow();
+    break;
+  case HCI_TL_SPI_TX:
+    spi_state = HCI_TL_SPI_IDLE;
+    break;
+  default:
+    break;
+  }
+}
+
+/**
+ * @brief  SPI1 transfer error callback, drops the current transfer.
+ *
+ * @param  hspi : SPI handle
+ * @retval None
+ */
+static void HCI_TL_SPI_TransferError(SPI_HandleTypeDef* hspi)
+{
+  if (spi_state != HCI_TL_SPI_TX)
+  {
+    HAL_GPIO_WritePin(HCI_TL_SPI_CS_PORT, HCI_TL_SPI_CS_PIN, GPIO_PIN_SET);
+  }
+
+  HCI_TL_SPI_DropPacket();
+}
+
 /**
  * @brief  Reports if the BlueNRG has data for the host micro.
  *
@@ -343,13 +670,15 @@ void hci_tl_lowlevel_init(void)
   */
 void hci_tl_lowlevel_isr(void)
 {
-  /* Call hci_notify_asynch_evt() */
-  while(IsDataAvailable())
+  /* A falling edge releases the read in progress, a rising edge starts the next one.
+   * The packet is queued by hci_notify_asynch_evt() once the read is released. */
+  if (spi_state == HCI_TL_SPI_RX_RELEASE)
   {
-    if (hci_notify_asynch_evt(NULL))
-    {
-      return;
-    }
+    HCI_TL_SPI_PollIrqLow();
+  }
+  else
+  {
+    HCI_TL_SPI_StartReceive();
   }
 
   /* USER CODE BEGIN hci_tl_lowlevel_isr */
@@ -357,3 +686,41 @@ void hci_tl_lowlevel_isr(void)
 
   /* USER CODE END hci_tl_lowlevel_isr */
 }
+
+/**
+  * @brief Restarts a read that was deferred because the HCI packet pool was empty,
+  *        and releases a read whose IRQ line never fell in time.
+  *        Called from the main loop after events have been processed.
+  *
+  * @param  None
+  * @retval None
+  */
+void hci_tl_lowlevel_resume(void)
+{
+  HCI_TL_SPI_PollIrqLow();
+  HCI_TL_SPI_StartReceive();
+}
+
+/**
+  * @brief This function handles DMA1 stream0 global interrupt (SPI1 RX).
+  */
+void DMA1_Stream0_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi1_rx);
+}
+
+/**
+  * @brief This function handles DMA1 stream1 global interrupt (SPI1 TX).
+  */
+void DMA1_Stream1_IRQHandler(void)
+{
+  HAL_DMA_IRQHandler(&hdma_spi1_tx);
+}
+
+/**
+  * @brief This function handles SPI1 global interrupt.
+  */
+void SPI1_IRQHandler(void)
+{
+  HAL_SPI_IRQHandler(&hspi1);
+}
@@ -69,6 +69,14 @@ void hci_tl_lowlevel_init(void);
  */
 void hci_tl_lowlevel_isr(void);
 
+/**
+ * @brief Restarts a read that was deferred because the HCI packet pool was empty
+ *
+ * @param  None
+ * @retval None
+ */
+void hci_tl_lowlevel_resume(void);
+
 #ifdef __cplusplus
 }
 #endif
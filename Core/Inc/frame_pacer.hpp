@@ -0,0 +1,138 @@
+/**
+ * @file frame_pacer.hpp
+ * @author Aidan Orr
+ * @brief Fixed rate frame pacing of the render loop
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+#pragma once
+
+#include "high_precision_counter.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Paces the render loop to a fixed frame period that is a whole number of LED driver display periods
+ * @remark Each frame starts on a boundary of a fixed grid, so VSYNC is sent at a steady rate regardless of how long the
+ * SPI transfers or the BLE work took. The time left after rendering and transmitting is given to deferred work and BLE.
+ */
+class FramePacer
+{
+  public:
+	/// @brief Phases of a frame that have a time budget
+	enum struct Phase : uint8_t
+	{
+		Render,   ///< @brief Latching the previous frame with VSYNC and mapping voxel colors to driver LEDs
+		Transmit, ///< @brief Writing the SRAM data to the drivers
+		Count,
+	};
+
+	static constexpr size_t PhaseCount = static_cast<size_t>(Phase::Count);
+
+	/// @brief Time in microseconds a frame may start after its boundary before its deadline counts as missed
+	static constexpr uint32_t MaxLateness = 100;
+
+  private:
+	HighPrecisionCounter& counter;
+
+	uint32_t framePeriod                      = 20000; ///< @brief Frame period in microseconds
+	std::array<uint32_t, PhaseCount> budgets  = { 0 }; ///< @brief Time budget of each phase in microseconds
+	std::array<uint32_t, PhaseCount> overruns = { 0 }; ///< @brief Number of frames each phase ran past its budget
+	uint64_t frameStart                       = 0;     ///< @brief Boundary at which the current frame started
+	uint64_t phaseStart                       = 0;     ///< @brief Start of the current phase
+
+	uint32_t missedDeadlines  = 0; ///< @brief Frames that started late or were skipped entirely
+	uint32_t skippedTransmits = 0; ///< @brief Frames that did not transmit because nothing changed
+
+  public:
+	/**
+	 * @brief Construct a new FramePacer object
+	 *
+	 * @param counter The counter used to time the frames
+	 */
+	constexpr FramePacer(HighPrecisionCounter& counter)
+		: counter(counter)
+	{}
+
+	/**
+	 * @brief Set the frame rate and budgets, and restart pacing with the first frame due immediately
+	 *
+	 * @param frameRate The target frame rate in Hz, rounded to a whole number of display periods
+	 * @param displayPeriod The display period of the LED drivers in microseconds
+	 * @param renderBudget The time budget of the render phase in microseconds
+	 * @param transmitBudget The time budget of the transmit phase in microseconds
+	 * @return `uint32_t` The frame period in microseconds
+	 */
+	uint32_t Configure(float frameRate, uint32_t displayPeriod, uint32_t renderBudget, uint32_t transmitBudget);
+
+	/**
+	 * @brief Start the next frame on the frame grid, counting the deadlines missed since the last frame
+	 */
+	void BeginFrame();
+
+	/**
+	 * @brief Mark the end of a phase, the next phase starts immediately
+	 *
+	 * @param phase The phase that just completed
+	 */
+	void EndPhase(Phase phase)
+	{
+		uint64_t now = counter.GetCount();
+		if (now - phaseStart > budgets[static_cast<size_t>(phase)])
+			overruns[static_cast<size_t>(phase)]++;
+
+		phaseStart = now;
+	}
+
+	/**
+	 * @brief Mark the transmit phase as skipped because nothing changed since the last frame
+	 */
+	void SkipTransmit()
+	{
+		skippedTransmits++;
+		phaseStart = counter.GetCount();
+	}
+
+	/**
+	 * @brief Get the time at which the next frame starts
+	 *
+	 * @return `uint64_t` The counter value in microseconds
+	 */
+	uint64_t GetFrameDeadline() const { return frameStart + framePeriod; }
+
+	/**
+	 * @brief Check whether the next frame is due
+	 *
+	 * @return `bool` Whether the frame boundary has been reached
+	 */
+	bool IsFrameDue() const { return counter.GetCount() >= GetFrameDeadline(); }
+
+	/**
+	 * @brief Get the time of each frame left for deferred work and BLE
+	 *
+	 * @return `uint32_t` The idle budget in microseconds
+	 */
+	uint32_t GetIdleBudget() const
+	{
+		uint32_t busy = 0;
+		for (uint32_t budget : budgets)
+			busy += budget;
+
+		return framePeriod > busy ? framePeriod - busy : 0;
+	}
+
+	uint32_t GetFramePeriod() const { return framePeriod; }
+
+	uint32_t GetMissedDeadlines() const { return missedDeadlines; }
+
+	uint32_t GetSkippedTransmits() const { return skippedTransmits; }
+
+	uint32_t GetOverruns(Phase phase) const { return overruns[static_cast<size_t>(phase)]; }
+};
+
+} // namespace LumiVoxel
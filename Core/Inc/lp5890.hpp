@@ -20,29 +20,53 @@
 #include <algorithm>
 #include <array>
 #include <cstdint>
+#include <span>
 
 namespace LumiVoxel::Lp5890
 {
 
 /**
- * @brief LP5890 LED driver class
- *
- * @tparam ledCount Number of LEDs connected to the driver
+ * @brief LP5890 LED driver class, drives a daisy chain of LP5890s behind one LP5899
+ * @remark LED `chip * LedCount + i` is LED `i` of the chip at position `chip` in the chain, the chip nearest the
+ * LP5899 is chip 0. Every CCSI command carries 48 bits for each chip in the chain, the data of the last chip first, so
+ * one SRAM write sends the same LED of every chip and a frame takes `LedCount` writes whatever the chain length. The
+ * configuration registers are written to every chip alike. FC0 `ChipNumber` must match the chain length.
  */
 class Driver
 {
   public:
-	static constexpr uint16_t ColorMax = 65535;
-	static constexpr uint16_t ColorMin = 0;
-	static constexpr size_t LedCount   = 256;
+	static constexpr uint16_t ColorMax     = 65535;
+	static constexpr uint16_t ColorMin     = 0;
+	static constexpr size_t LedCount       = 256; ///< @brief LEDs driven by each chip in the chain
+	static constexpr size_t LineLength     = 16;  ///< @brief RGB channels driven on each scan line
+	static constexpr size_t MaxChainLength = 32;  ///< @brief Most chips FC0 `ChipNumber` can address
+
+	static constexpr uint8_t DefaultCcsiDataRate = 0xA;      ///< @brief Default CCSI data rate setting (5Mbps)
+	static constexpr uint32_t GclkTarget         = 60000000; ///< @brief GCLK frequency in Hz kept as the CCSI data rate changes
+
+	static constexpr size_t ConfigRegisterCount = 5;       ///< @brief Configuration registers FC0-FC4 shadowed by the driver
+	static constexpr uint8_t TimingConfig       = 0b00011; ///< @brief Dirty bits of FC0 and FC1, which set the display period
+
+	/// @brief How the integrity of the SRAM writes streamed each frame is checked
+	struct IntegrityPolicy
+	{
+		bool Sampled;            ///< @brief Stream without CRC and check samples, false to check the CRC of every write
+		uint16_t SampleInterval; ///< @brief One SRAM write in this many is sent with CRC, the sampled LEDs rotate each frame
+		uint16_t StatusInterval; ///< @brief Frames between global status polls while sampling
+		uint16_t RecoveryFrames; ///< @brief Error free frames in full CRC mode before sampling resumes
+	};
 
-	static constexpr uint16_t CcsiClock = 0xA; ///< @brief CCSI clock rate (5MHz)
+	static constexpr IntegrityPolicy DefaultIntegrityPolicy = {
+		.Sampled        = true,
+		.SampleInterval = 32,
+		.StatusInterval = 1,
+		.RecoveryFrames = 500,
+	};
 
   private:
 	Lp5899& interface;
-	std::array<uint16_t, LedCount> red   = { 0 };
-	std::array<uint16_t, LedCount> green = { 0 };
-	std::array<uint16_t, LedCount> blue  = { 0 };
+	std::span<Color> colors; ///< @brief Colors of every LED of the chain, `LedCount` for each chip
+	size_t chainLength;      ///< @brief Number of chips in the chain
 	float& brightness;
 
 	uint8_t globalBrightness     = 7;
@@ -56,7 +80,50 @@ class Driver
 	Lp5890::FC3& fc3Config;
 	Lp5890::FC4& fc4Config;
 
-	bool initialized = false;
+	/// @brief Write commands of the configuration registers, indexed by register number
+	static constexpr std::array<Command, ConfigRegisterCount> ConfigCommands = {
+		Command::FC0_WRITE, Command::FC1_WRITE, Command::FC2_WRITE, Command::FC3_WRITE, Command::FC4_WRITE
+	};
+
+	std::array<const std::array<uint16_t, 3>*, ConfigRegisterCount> configValues;       ///< @brief Values of FC0-FC4 to display
+	std::array<std::array<uint16_t, 3>, ConfigRegisterCount> writtenConfig = { { 0 } }; ///< @brief Values of FC0-FC4 last written to the chip
+
+	uint8_t ccsiDataRate = DefaultCcsiDataRate; ///< @brief CCSI data rate setting of the LP5899, see `Lp5899::CcsiDataRates`
+
+	IntegrityPolicy integrityPolicy = DefaultIntegrityPolicy;
+	bool fullCrc                    = false; ///< @brief Whether an integrity error forced every write to be CRC checked
+	uint16_t cleanFrames            = 0;     ///< @brief Error free frames since falling back to full CRC
+	uint16_t sampleOffset           = 0;     ///< @brief First SRAM write sent with CRC in the next sampled frame
+	uint16_t statusFrames           = 0;     ///< @brief Sampled frames since the last global status poll
+	uint32_t fallbackCount          = 0;     ///< @brief Number of falls back to full CRC
+
+	bool writing           = false; ///< @brief Whether a color write started with `TryBeginWriteColors` is in progress
+	bool writeFullCrc      = false; ///< @brief Whether every SRAM write of the color write in progress is CRC checked
+	uint16_t writeIndex    = 0;     ///< @brief Next LED sent by the color write in progress
+	uint16_t writeInterval = 1;     ///< @brief Sample interval of the color write in progress
+
+	bool initialized       = false;
+	bool modified          = true;  ///< @brief Whether the colors changed since they were last written to the driver
+	bool latchPending      = false; ///< @brief Whether a completed color write waits for VSYNC to be displayed
+	bool statusPollPending = false; ///< @brief Whether a completed color write waits for its global status poll
+
+	/// @brief Check every write with CRC until the link has been error free for `IntegrityPolicy::RecoveryFrames`
+	void FallBackToFullCrc();
+
+	/// @brief Mark the configuration and colors to be written again after the link recovered
+	void Resync();
+
+	/// @brief Stop the color write in progress after an error, leaving the colors modified
+	void AbortWriteColors();
+
+	/// @brief Update the integrity state once a color write completes, the write is latched unless its status poll is due
+	bool TryFinishWriteColors();
+
+	/// @brief Position of the data of a chip in a CCSI command, the data of the last chip in the chain is shifted first
+	size_t GetChainSlot(size_t chip) const { return chainLength - 1 - chip; }
+
+	/// @brief Forward a register write with the same value for every chip, without checking initialization
+	bool TryForwardRegister(Command command, const std::array<uint16_t, 3>& value);
 
 	/// @brief Quantizes a color value to the range of 0-ColorMax
 	/// @param color The color value to quantize (0.0-1.0)
@@ -72,10 +139,12 @@ class Driver
 	 * @brief Construct a new Lp5890 Driver object
 	 *
 	 * @param interface A reference to the LP5899 interface object
+	 * @param colors Storage for the colors of the chain, `LedCount` for each chip, its size sets the chain length
 	 * @param brightness A reference to the brightness value
 	 */
 	constexpr Driver(
 		Lp5899& interface,
+		std::span<Color> colors,
 		float& brightness,
 		Lp5890::FC0& fc0,
 		Lp5890::FC1& fc1,
@@ -83,12 +152,15 @@ class Driver
 		Lp5890::FC3& fc3,
 		Lp5890::FC4& fc4)
 		: interface(interface),
+		  colors(colors),
+		  chainLength(colors.size() / LedCount),
 		  brightness(brightness),
 		  fc0Config(fc0),
 		  fc1Config(fc1),
 		  fc2Config(fc2),
 		  fc3Config(fc3),
-		  fc4Config(fc4)
+		  fc4Config(fc4),
+		  configValues({ &fc0.Value, &fc1.Value, &fc2.Value, &fc3.Value, &fc4.Value })
 	{}
 
 	/**
@@ -100,30 +172,261 @@ class Driver
 	bool Init(HighPrecisionCounter& hpc);
 
 	/// @brief Set the brightness of an LED and quantizes the color values
-	/// @param index The index of the LED to set (0-LedCount-1)
+	/// @param index The index of the LED in the chain to set (0-GetLedCount()-1)
 	/// @param red The brightness of the red channel (0.0-1.0)
 	/// @param green The brightness of the green channel (0.0-1.0)
 	/// @param blue The brightness of the blue channel (0.0-1.0)
 	void SetColor(size_t index, float red, float green, float blue)
 	{
-		if (index >= LedCount)
+		if (index >= colors.size())
 			return;
 
-		this->red[index]   = QuantizeColor(red * brightness);
-		this->green[index] = QuantizeColor(green * brightness);
-		this->blue[index]  = QuantizeColor(blue * brightness);
+		Color color = {
+			.Blue  = QuantizeColor(blue * brightness),
+			.Green = QuantizeColor(green * brightness),
+			.Red   = QuantizeColor(red * brightness),
+		};
+
+		Color& current = colors[index];
+		modified |= current.Red != color.Red || current.Green != color.Green || current.Blue != color.Blue;
+
+		current = color;
 	}
 
 	void FillColors(float r, float g, float b)
 	{
-		red.fill(QuantizeColor(r * brightness));
-		green.fill(QuantizeColor(g * brightness));
-		blue.fill(QuantizeColor(b * brightness));
+		std::fill(colors.begin(), colors.end(), Color{ QuantizeColor(b * brightness), QuantizeColor(g * brightness), QuantizeColor(r * brightness) });
+		modified = true;
 	}
 
+	/// @brief Get the number of chips in the chain
+	size_t GetChainLength() const { return chainLength; }
+
+	/// @brief Get the number of LEDs driven by the chain
+	size_t GetLedCount() const { return chainLength * LedCount; }
+
+	/// @brief Whether the colors changed since they were last written to the driver
+	bool IsModified() const { return modified; }
+
+	/**
+	 * @brief Get the time the driver takes to display a complete frame with the configured scan settings
+	 * @remark Each sub-period scans every line once, and each line takes a segment plus the line switch time
+	 *
+	 * @return `uint32_t` The display period in microseconds
+	 */
+	uint32_t GetDisplayPeriod() const;
+
+	/**
+	 * @brief Write the colors of every LED to the SRAM of the driver
+	 * @remark With a sampled integrity policy the writes are forwarded without CRC, except for one in every
+	 * `SampleInterval`, and the global status is polled after the frame. Any error falls back to checking the CRC of
+	 * every write and leaves the colors modified so the frame is written again.
+	 *
+	 * @return `bool` Whether every write succeeded
+	 */
 	bool TryWriteColors();
 
+	/**
+	 * @brief Start writing the colors of every LED in the background, with the same integrity checks as `TryWriteColors`
+	 * @remark Call `TryServiceWriteColors` until `IsWritingColors` is false. Each call only waits on the CPU, so the
+	 * writes of drivers on separate interfaces run at the same time.
+	 *
+	 * @return `bool` Whether the write was started
+	 */
+	bool TryBeginWriteColors();
+
+	/**
+	 * @brief Advance the color write in progress without blocking, sending the next LED once the last one completed
+	 * @remark On an error the write is abandoned and falls back to full CRC, the colors stay modified
+	 *
+	 * @return `bool` false if the write failed, true while it runs and once it completes successfully
+	 */
+	bool TryServiceWriteColors();
+
+	/// @brief Whether a color write started with `TryBeginWriteColors` is in progress
+	bool IsWritingColors() const { return writing; }
+
+	/**
+	 * @brief Whether a completed color write waits for `TryPollStatus` before it can be latched
+	 */
+	bool IsStatusPollPending() const { return statusPollPending; }
+
+	/**
+	 * @brief Read the global status after a color write with sampled CRC and latch the write if it shows no error
+	 * @remark Blocks on the bus of the interface, so it is deferred until no other link is writing
+	 *
+	 * @return `bool` Whether the status was read and shows no error
+	 */
+	bool TryPollStatus();
+
+	/**
+	 * @brief Whether the last color write completed and waits for VSYNC to be displayed
+	 * @remark Cleared when a write starts, so a write that failed part way is never latched
+	 */
+	bool IsLatchPending() const { return latchPending; }
+
+	/**
+	 * @brief Set how the integrity of the streamed SRAM writes is checked
+	 */
+	void SetIntegrityPolicy(const IntegrityPolicy& policy)
+	{
+		integrityPolicy = policy;
+
+		// An offset past a shorter interval would never match, leaving the next frame without any CRC sample
+		sampleOffset %= std::max<uint16_t>(policy.SampleInterval, 1);
+	}
+
+	/**
+	 * @brief Whether every SRAM write is currently checked with CRC, by policy or after an integrity error
+	 */
+	bool IsFullCrc() const { return !integrityPolicy.Sampled || fullCrc; }
+
+	/**
+	 * @brief Get the number of times an integrity error forced a fall back to full CRC
+	 */
+	uint32_t GetFallbackCount() const { return fallbackCount; }
+
 	bool TrySendVsync();
+
+	/**
+	 * @brief Build the VSYNC command without sending it, send it with `TryStartVsync`
+	 * @remark Lets the VSYNC of several drivers start back to back so their frames latch together
+	 *
+	 * @return `bool` Whether the command was prepared
+	 */
+	bool TryPrepareVsync();
+
+	/**
+	 * @brief Start sending the prepared VSYNC command, complete it with `TryServiceVsync`
+	 *
+	 * @return `bool` Whether the command was started
+	 */
+	bool TryStartVsync();
+
+	/**
+	 * @brief Advance the VSYNC command without blocking, call until `IsTransferActive` is false
+	 *
+	 * @return `bool` false if the command failed, true while it runs and once it completes successfully
+	 */
+	bool TryServiceVsync();
+
+	/// @brief Whether a background transfer to the driver is prepared or running
+	bool IsTransferActive() const { return interface.IsTransferActive(); }
+
+	/**
+	 * @brief Change the CCSI data rate, retuning the GCLK multiplier in FC0 to stay near `GclkTarget`
+	 * @remark Before `Init` only the setting is stored. Once initialized the multiplier is lowered before the rate is
+	 * raised, and raised after the rate is lowered, so GCLK never overshoots while the two disagree. Drivers sharing
+	 * FC0 must run at the same data rate. `GetDisplayPeriod` changes with the rate.
+	 *
+	 * @param rate The CCSI data rate setting (0-15), see `Lp5899::CcsiDataRates`
+	 * @return `bool` Whether the rate was applied
+	 */
+	bool TrySetCcsiDataRate(uint8_t rate);
+
+	/**
+	 * @brief Get the CCSI data rate setting, see `Lp5899::CcsiDataRates`
+	 */
+	uint8_t GetCcsiDataRate() const { return ccsiDataRate; }
+
+	/**
+	 * @brief Attempt recovery of an unhealthy link once its backoff has expired, call once per frame
+	 * @remark After a recovery every configuration register is dirty and the colors are modified, so the next frame
+	 * sends the full state of the driver again
+	 */
+	void ServiceLink();
+
+	/**
+	 * @brief Attempt recovery of an unhealthy link now, ignoring the backoff
+	 *
+	 * @return `bool` Whether the link is healthy
+	 */
+	bool TryRecoverLink();
+
+	/**
+	 * @brief Whether transfers are forwarded to the driver
+	 */
+	bool IsLinkHealthy() const { return interface.IsLinkHealthy(); }
+
+	/**
+	 * @brief Get the number of CRC mismatches and CCSI errors seen on the link to the driver
+	 */
+	uint32_t GetLinkErrorCount() const { return interface.GetCrcErrorCount() + interface.GetCcsiErrorCount(); }
+
+	/**
+	 * @brief Get the configuration registers that changed since they were last written to the chip
+	 * @remark The FC0-FC4 objects passed to the constructor are the shadow, change their fields and push them with
+	 * `TryWriteDirtyConfig`. Drivers sharing the same objects all see the change.
+	 *
+	 * @return `uint8_t` Bit n is set if FCn changed
+	 */
+	uint8_t GetDirtyConfig() const;
+
+	/**
+	 * @brief Mark configuration registers dirty and the colors modified, so the next frame sends them again
+	 * @remark Used when a chip is found not to hold what was sent, the registers are written by `TryWriteDirtyConfig`
+	 *
+	 * @param config Bit n is set to write FCn again
+	 */
+	void Retransmit(uint8_t config);
+
+	/**
+	 * @brief Write only the configuration registers that changed since they were last written
+	 * @remark Call between frames, before VSYNC, so the new configuration applies from the frame that VSYNC latches.
+	 * Changes to `TimingConfig` registers change `GetDisplayPeriod`.
+	 *
+	 * @return `bool` Whether every changed register was written
+	 */
+	bool TryWriteDirtyConfig();
+
+	/**
+	 * @brief Get the value of a configuration register last written to the chip
+	 *
+	 * @param index The register number (0-4)
+	 * @return `const std::array<uint16_t, 3>&` The register value, least significant word first
+	 */
+	const std::array<uint16_t, 3>& GetWrittenConfig(size_t index) const { return writtenConfig[index]; }
+
+	/**
+	 * @brief Get the number of scan lines configured in FC0
+	 */
+	size_t GetScanLineCount() const { return fc0Config.ScanLineNumber + 1; }
+
+	/**
+	 * @brief Write a 48 bit register of every chip in the chain
+	 *
+	 * @param command The write command of the register
+	 * @param value The register value, least significant word first
+	 * @return `bool` Whether the register was written
+	 */
+	bool TryWriteRegister(Command command, const std::array<uint16_t, 3>& value);
+
+	/**
+	 * @brief Read a 48 bit register of every chip in the chain, waiting for the reply
+	 * @remark Blocks for the CCSI round trip, use `TryRequestRegister` and `TryFetchRegister` in the render loop
+	 *
+	 * @param command The read command of the register
+	 * @param values The register value of each chip, chip 0 first, least significant word first, one per chip
+	 * @return `bool` Whether the values were read
+	 */
+	bool TryReadRegister(Command command, std::span<std::array<uint16_t, 3>> values);
+
+	/**
+	 * @brief Forward the read command of a 48 bit register without waiting for the reply
+	 * @remark Collect the value with `TryFetchRegister` on a later call, so the frame never waits for the CCSI round trip
+	 *
+	 * @param command The read command of the register
+	 * @return `bool` Whether the read command was forwarded
+	 */
+	bool TryRequestRegister(Command command);
+
+	/**
+	 * @brief Read the values returned for the last `TryRequestRegister`
+	 *
+	 * @param values The register value of each chip, chip 0 first, least significant word first, one per chip
+	 * @return `bool` Whether the values were read
+	 */
+	bool TryFetchRegister(std::span<std::array<uint16_t, 3>> values);
 };
 
 } // namespace LumiVoxel::Lp5890
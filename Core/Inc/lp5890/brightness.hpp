@@ -0,0 +1,71 @@
+/**
+ * @file brightness.hpp
+ * @author Aidan Orr
+ * @brief Brightness control of the LP5890 through its analog global and color group brightness
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#pragma once
+
+#include "lp5890/registers.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace LumiVoxel::Lp5890
+{
+
+/**
+ * @brief Splits a requested brightness into the global brightness and color group brightness of FC3, with a digital
+ * scale for what the analog controls cannot reach
+ * @remark The output current is taken as proportional to `(GlobalBrightness + 1) / 8` and to
+ * `(ColorBrightness + 1) / 256`. The color group brightness in FC3 at construction is the color balance at full
+ * brightness and is scaled down from there. Inside the analog range the digital scale stays at 1, so brightness changes
+ * only rewrite FC3 and leave the grayscale data, and its full 16 bit precision, untouched.
+ */
+class BrightnessControl
+{
+  public:
+	static constexpr uint8_t GlobalLevels = 8; ///< @brief Number of global brightness levels
+	/// @brief Lowest color group scale used before falling back to the digital scale, keeps the color balance accurate
+	static constexpr float MinGroupScale = 1.0f / 8.0f;
+
+  private:
+	FC3& fc3;
+	float& digitalScale;
+	std::array<uint8_t, 3> balance; ///< @brief Red, green and blue group brightness at full brightness
+
+	float requested = -1.0f; ///< @brief The last requested brightness, negative before the first request
+
+  public:
+	/**
+	 * @brief Construct a new Brightness Control object
+	 *
+	 * @param fc3 The FC3 register shared with the drivers, its color group brightness is the color balance
+	 * @param digitalScale The brightness the drivers scale grayscale data by, set to the residual of the analog controls
+	 */
+	BrightnessControl(FC3& fc3, float& digitalScale)
+		: fc3(fc3),
+		  digitalScale(digitalScale),
+		  balance({ static_cast<uint8_t>(fc3.RedColorBrightness),
+		            static_cast<uint8_t>(fc3.GreenColorBrightness),
+		            static_cast<uint8_t>(fc3.BlueColorBrightness) })
+	{}
+
+	/**
+	 * @brief Set the brightness, updating FC3 and the digital scale
+	 * @remark FC3 is only changed here, it is written to the drivers with `Driver::TryWriteDirtyConfig`
+	 *
+	 * @param brightness The brightness (0.0-1.0)
+	 */
+	void Set(float brightness);
+
+	/**
+	 * @brief Get the last requested brightness
+	 */
+	float Get() const { return requested < 0.0f ? 1.0f : requested; }
+};
+
+} // namespace LumiVoxel::Lp5890
@@ -0,0 +1,137 @@
+/**
+ * @file diagnostics.hpp
+ * @author Aidan Orr
+ * @brief Incremental LED open and short detection of the LP5890
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#pragma once
+
+#include "lp5890.hpp"
+#include "lp5890/registers.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+namespace LumiVoxel::Lp5890
+{
+
+/**
+ * @brief Reads the LED open (LOD) and short (LSD) detection registers of a driver one register access at a time
+ * @remark A sweep reads the line warnings from FC12, then for each flagged line selects it with FC10 and reads its
+ * channel warnings from FC14, then does the same for shorts with FC13, FC11 and FC15. Each call to `Step` performs a
+ * single register access, read commands are forwarded on one call and their reply collected on the next, so the
+ * frame never waits for the CCSI round trip. Every chip of a chain replies to each read, so one sweep covers the whole
+ * chain. Detection only happens on LEDs that are driven, so faults of LEDs that stay dark are not reported.
+ */
+class Diagnostics
+{
+  public:
+	static constexpr uint8_t RedOpen    = 1 << 0;
+	static constexpr uint8_t GreenOpen  = 1 << 1;
+	static constexpr uint8_t BlueOpen   = 1 << 2;
+	static constexpr uint8_t RedShort   = 1 << 3;
+	static constexpr uint8_t GreenShort = 1 << 4;
+	static constexpr uint8_t BlueShort  = 1 << 5;
+
+	static constexpr uint8_t OpenFaults  = RedOpen | GreenOpen | BlueOpen;
+	static constexpr uint8_t ShortFaults = RedShort | GreenShort | BlueShort;
+
+	/// @brief Called with the chain LED index and its new faults whenever the faults of an LED change
+	using FaultCallback = std::function<void(size_t index, uint8_t faults)>;
+
+  private:
+	enum struct Stage : uint8_t
+	{
+		RequestLines,    ///< @brief Forward the read of the line warnings
+		FetchLines,      ///< @brief Collect the line warnings
+		SelectLine,      ///< @brief Select the next flagged line
+		RequestChannels, ///< @brief Forward the read of the channel warnings of the selected line
+		FetchChannels,   ///< @brief Collect the channel warnings of the selected line
+	};
+
+	/// @brief Registers used to detect one kind of fault
+	struct Detection
+	{
+		Command LineRead;    ///< @brief Read the lines with warnings
+		Command LineSelect;  ///< @brief Select the line the channel warnings are read for
+		Command ChannelRead; ///< @brief Read the channels with warnings on the selected line
+		uint8_t Shift;       ///< @brief Position of the red flag of this kind of fault
+	};
+
+	static constexpr std::array<Detection, 2> Detections = { {
+		{ Command::FC12_READ, Command::FC10_WRITE, Command::FC14_READ, 0 },
+		{ Command::FC13_READ, Command::FC11_WRITE, Command::FC15_READ, 3 },
+	} };
+
+	Driver& driver;
+	FaultCallback onFaultChange;
+
+	std::span<uint8_t> faults; ///< @brief Fault flags of every LED of the chain
+
+	Stage stage       = Stage::RequestLines;
+	uint8_t detection = 0; ///< @brief Index of the kind of fault being detected in `Detections`
+	uint8_t line      = 0; ///< @brief The line whose channel warnings are being read
+	uint32_t lineMask = 0; ///< @brief Lines with warnings of the kind being detected
+
+	uint32_t sweepCount = 0; ///< @brief Number of completed sweeps over both kinds of fault
+	uint32_t errorCount = 0; ///< @brief Number of failed register accesses
+
+	void UpdateLine(size_t chip, size_t scanLine, uint64_t channels);
+	void NextLine();
+
+  public:
+	/**
+	 * @brief Construct a new Diagnostics object
+	 *
+	 * @param driver The driver to run diagnostics on
+	 * @param faults Storage for the fault flags, one for each LED of the chain
+	 */
+	Diagnostics(Driver& driver, std::span<uint8_t> faults)
+		: driver(driver),
+		  faults(faults)
+	{}
+
+	/**
+	 * @brief Set the function called when the faults of an LED change
+	 */
+	void SetFaultCallback(const FaultCallback& callback) { onFaultChange = callback; }
+
+	/**
+	 * @brief Perform the next register access of the sweep
+	 * @remark A failed access restarts the detection of the current kind of fault
+	 *
+	 * @return `bool` Whether the register access succeeded
+	 */
+	bool Step();
+
+	/**
+	 * @brief Whether a read was forwarded and its reply is collected by the next `Step`
+	 * @remark The reply waits in the RX FIFO of the interface, no other read may be forwarded until it was collected
+	 */
+	bool IsAwaitingReply() const { return stage == Stage::FetchLines || stage == Stage::FetchChannels; }
+
+	/**
+	 * @brief Get the faults of an LED
+	 *
+	 * @param index The chain LED index
+	 * @return `uint8_t` The fault flags of the LED
+	 */
+	uint8_t GetFaults(size_t index) const { return index < faults.size() ? faults[index] : 0; }
+
+	/**
+	 * @brief Get the number of completed sweeps
+	 */
+	uint32_t GetSweepCount() const { return sweepCount; }
+
+	/**
+	 * @brief Get the number of failed register accesses
+	 */
+	uint32_t GetErrorCount() const { return errorCount; }
+};
+
+} // namespace LumiVoxel::Lp5890
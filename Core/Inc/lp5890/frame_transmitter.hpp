@@ -0,0 +1,60 @@
+/**
+ * @file frame_transmitter.hpp
+ * @author Aidan Orr
+ * @brief Writes a frame to LED drivers on separate interfaces at the same time
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#pragma once
+
+#include "lp5890.hpp"
+
+#include <functional>
+#include <span>
+
+namespace LumiVoxel::Lp5890
+{
+
+/**
+ * @brief Drives the links of several LED drivers concurrently, each on its own LP5899 and SPI peripheral
+ * @remark Every SRAM write runs on the SPI interrupt, so while one link shifts its data the CPU starts the next write
+ * on the others and the frame takes about as long as the slowest link rather than the sum of them. The blocking global
+ * status polls after sampled writes only run once every link finished writing. The VSYNC commands
+ * are prepared first and started back to back with interrupts disabled, so the chains latch their frames within a few
+ * microseconds of each other. The SPI interrupt of every interface must be enabled.
+ */
+class FrameTransmitter
+{
+	std::span<const std::reference_wrapper<Driver>> drivers;
+
+  public:
+	/**
+	 * @brief Construct a new Frame Transmitter object
+	 *
+	 * @param drivers The drivers to write, each on a different interface
+	 */
+	constexpr FrameTransmitter(std::span<const std::reference_wrapper<Driver>> drivers)
+		: drivers(drivers)
+	{}
+
+	/**
+	 * @brief Write the colors of every driver whose colors changed, all links at the same time
+	 * @remark A driver whose write fails is left modified and is written again on the next frame, the other drivers
+	 * still complete their writes
+	 *
+	 * @return `bool` Whether any driver has a completed write that needs a VSYNC to display it
+	 */
+	bool TransmitColors();
+
+	/**
+	 * @brief Send VSYNC to every driver with a completed write, starting the commands as close together as possible
+	 * @remark A driver whose write failed or was cut short is not latched, so it keeps displaying its last full frame
+	 *
+	 * @return `bool` Whether every driver with a completed write was sent VSYNC
+	 */
+	bool TrySendVsync();
+};
+
+} // namespace LumiVoxel::Lp5890
@@ -0,0 +1,85 @@
+/**
+ * @file link_training.hpp
+ * @author Aidan Orr
+ * @brief Search for the highest CCSI data rate the LED driver links run without errors
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#pragma once
+
+#include "lp5890.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+
+namespace LumiVoxel::Lp5890
+{
+
+/**
+ * @brief Trains the CCSI data rate of a set of drivers sharing one configuration
+ * @remark Training steps the data rate of every driver up together from the current rate. Each rate is validated over a
+ * number of frames, each frame streams the full SRAM image, sends VSYNC and reads FC0-FC4 of every chip back with CRC
+ * checks. The highest rate with no read-back mismatches and no new CRC or CCSI errors is kept and stored in flash. Later
+ * boots validate the stored rate and only search again if it fails. Training blocks on the CCSI round trip of every
+ * read and must run before the render loop.
+ */
+class LinkTraining
+{
+  public:
+	/// @brief Layout key of the stored training result
+	static constexpr uint16_t StoreKey = 0x4C54;
+
+	/// @brief Training result kept in flash
+	struct Result
+	{
+		uint8_t DataRate; ///< @brief The trained CCSI data rate setting
+		uint8_t Reserved[3];
+	};
+
+  private:
+	std::span<const std::reference_wrapper<Driver>> drivers;
+
+	bool TrySetRate(uint8_t rate);
+	bool TryRestoreRate(uint8_t rate);
+
+  public:
+	/**
+	 * @brief Construct a new Link Training object
+	 *
+	 * @param drivers The initialized drivers to train, all sharing the same FC0
+	 */
+	constexpr LinkTraining(std::span<const std::reference_wrapper<Driver>> drivers)
+		: drivers(drivers)
+	{}
+
+	/**
+	 * @brief Check that every driver runs at its current data rate without errors
+	 *
+	 * @param frames The number of frames to validate over
+	 * @return `bool` Whether every frame was error free on every driver
+	 */
+	bool Validate(size_t frames);
+
+	/**
+	 * @brief Step the data rate up from the current rate and keep the highest one that validates
+	 * @remark Falls back to the last rate that validated, the starting rate is assumed to be good
+	 *
+	 * @param frames The number of frames each rate is validated over
+	 * @return `uint8_t` The trained data rate setting
+	 */
+	uint8_t Train(size_t frames);
+
+	/**
+	 * @brief Apply the stored data rate if it still validates, otherwise train and store the result
+	 *
+	 * @param frames The number of frames each rate is validated over
+	 * @return `bool` Whether the drivers run at a validated rate
+	 */
+	bool TryConfigure(size_t frames);
+};
+
+} // namespace LumiVoxel::Lp5890
@@ -0,0 +1,136 @@
+/**
+ * @file link_verifier.hpp
+ * @author Aidan Orr
+ * @brief Read-back verification of the state written to the LP5890 over CCSI
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#pragma once
+
+#include "high_precision_counter.hpp"
+#include "lp5890.hpp"
+#include "lp5890/registers.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+
+namespace LumiVoxel::Lp5890
+{
+
+/**
+ * @brief Reads back what the chips of a driver hold and sends the frame again when it differs from what was written
+ * @remark The LP5890 has no SRAM read command, so the grayscale data cannot be compared directly. Each probe instead
+ * reads one of FC0-FC4 from every chip of the chain in rotation and compares it with the value last written, those
+ * writes cross the same CCSI link as the SRAM writes and a corrupted register shows a link that also corrupts the frame.
+ * On a mismatch the register is written again and the colors of the driver are sent again on the next frame. Like
+ * `Diagnostics` the read is forwarded on one call to `Step` and collected on the next, and probes are only due while
+ * their CCSI time stays within a share of the link bandwidth.
+ */
+class LinkVerifier
+{
+	static constexpr std::array<Command, Driver::ConfigRegisterCount> ConfigReads = {
+		Command::FC0_READ, Command::FC1_READ, Command::FC2_READ, Command::FC3_READ, Command::FC4_READ
+	};
+
+	/// @brief Probes of CCSI time that can build up while no probe is due
+	static constexpr float MaxCreditProbes = 4.0f;
+
+	Driver& driver;
+	HighPrecisionCounter& counter;
+
+	float overhead;          ///< @brief Share of the link bandwidth spent on probes, 0 disables verification
+	float credit        = 0; ///< @brief CCSI bits available to probes
+	uint64_t lastUpdate = 0; ///< @brief Time in microseconds the credit was last updated
+
+	bool awaitingReply               = false;
+	uint8_t nextRegister             = 0;     ///< @brief The configuration register read by the next probe
+	uint8_t probeRegister            = 0;     ///< @brief The configuration register read by the awaiting probe
+	std::array<uint16_t, 3> expected = { 0 }; ///< @brief Value last written to the register read by the awaiting probe
+
+	uint32_t probeCount    = 0; ///< @brief Number of completed probes
+	uint32_t mismatchCount = 0; ///< @brief Number of probes where a chip did not hold the written value
+	uint32_t errorCount    = 0; ///< @brief Number of failed register accesses
+
+	/// @brief CCSI bits of one probe, the read command and the 48 bit reply of every chip
+	float GetProbeBits() const { return 16.0f + 48.0f * driver.GetChainLength(); }
+
+	bool TryRequest();
+	bool TryCompare();
+
+  public:
+	/// @brief Share of the link bandwidth spent on probes by default
+	static constexpr float DefaultOverhead = 0.01f;
+
+	/**
+	 * @brief Construct a new Link Verifier object
+	 *
+	 * @param driver The driver whose link is verified
+	 * @param counter Time source used to meter the probes
+	 * @param overhead Share of the link bandwidth spent on probes, 0 disables verification
+	 */
+	LinkVerifier(Driver& driver, HighPrecisionCounter& counter, float overhead = DefaultOverhead)
+		: driver(driver),
+		  counter(counter),
+		  overhead(std::clamp(overhead, 0.0f, 1.0f))
+	{}
+
+	/**
+	 * @brief Set the share of the link bandwidth spent on probes
+	 *
+	 * @param overhead Share between 0 and 1, 0 disables verification
+	 */
+	void SetOverhead(float overhead) { this->overhead = std::clamp(overhead, 0.0f, 1.0f); }
+
+	/**
+	 * @brief Get the share of the link bandwidth spent on probes
+	 */
+	float GetOverhead() const { return overhead; }
+
+	/**
+	 * @brief Update the bandwidth available to probes and check whether a probe can start
+	 * @remark At the default overhead credit builds up faster than one probe per 40 ms diagnostics slot, a caller sharing
+	 * its read slots with `Diagnostics` has to limit the share of slots given to probes itself
+	 *
+	 * @return `bool` Whether verification is enabled, the link is healthy and the next probe fits the bandwidth share
+	 */
+	bool IsProbeDue();
+
+	/**
+	 * @brief Whether a read was forwarded and its reply is collected by the next `Step`
+	 * @remark The reply waits in the RX FIFO of the interface, no other read may be forwarded until it was collected
+	 */
+	bool IsAwaitingReply() const { return awaitingReply; }
+
+	/**
+	 * @brief Forward the read of the next probe, or collect and compare the reply of the one awaiting it
+	 *
+	 * @return `bool` Whether the register access succeeded
+	 */
+	bool Step();
+
+	/**
+	 * @brief Get the number of completed probes
+	 */
+	uint32_t GetProbeCount() const { return probeCount; }
+
+	/**
+	 * @brief Get the number of probes where a chip did not hold the written value
+	 * @remark Each mismatch sent the frame of the driver again
+	 */
+	uint32_t GetMismatchCount() const { return mismatchCount; }
+
+	/**
+	 * @brief Get the number of failed register accesses
+	 */
+	uint32_t GetErrorCount() const { return errorCount; }
+
+	/**
+	 * @brief Get the share of completed probes that found a mismatch
+	 */
+	float GetMismatchRate() const { return probeCount == 0 ? 0.0f : static_cast<float>(mismatchCount) / probeCount; }
+};
+
+} // namespace LumiVoxel::Lp5890
@@ -24,8 +24,11 @@ struct DriverMapping
 	static constexpr Driver* Empty = nullptr;
 
   public:
+	/// @brief Voxels driven by one LP5890, X by Y by Z, `LocalToDeviceMapping` is laid out over it
+	static constexpr std::array<size_t, 3> ModuleSize = { 8, 4, 8 };
+
 	std::reference_wrapper<Driver> LedDriver;
-	size_t Index;
+	size_t Index; ///< @brief The LED index in the chain of the driver
 
 	/// @brief Default constructor for DriverMapping
 	/// @warning This is only used internally to allow default construction, but should not be used in user code.
@@ -71,23 +74,49 @@ struct DriverMapping
 	// clang-format on
 };
 
-constexpr std::array<DriverMapping, 512> CreateDriverMappings(Driver& driver1, Driver& driver2)
+/**
+ * @brief Map a cube of voxels onto the chains of a set of drivers
+ * @remark The cube is tiled with `ModuleSize` blocks, one for each LP5890, numbered along X, then Y, then Z. The
+ * modules fill the chain of each driver in turn, module `m` is chip `m % chainLength` of driver `m / chainLength`, so
+ * every driver must be constructed with a chain of `X * Y * Z / (256 * DriverCount)` chips.
+ *
+ * @tparam X The size of the cube along X
+ * @tparam Y The size of the cube along Y
+ * @tparam Z The size of the cube along Z
+ * @tparam DriverCount The number of drivers
+ * @param drivers The drivers, in the order the modules are assigned to them
+ * @return `std::array<DriverMapping, X * Y * Z>` The driver and chain LED index of each voxel
+ */
+template <size_t X, size_t Y, size_t Z, size_t DriverCount>
+constexpr std::array<DriverMapping, X * Y * Z> CreateDriverMappings(const std::array<std::reference_wrapper<Driver>, DriverCount>& drivers)
 {
-	std::array<std::reference_wrapper<Driver>, 2> drivers = { std::ref(driver1), std::ref(driver2) };
+	constexpr std::array<size_t, 3> moduleSize = DriverMapping::ModuleSize;
+	static_assert(X % moduleSize[0] == 0 && Y % moduleSize[1] == 0 && Z % moduleSize[2] == 0, "The cube must be whole modules");
+
+	constexpr std::array<size_t, 3> modules = { X / moduleSize[0], Y / moduleSize[1], Z / moduleSize[2] };
+	constexpr size_t moduleCount            = modules[0] * modules[1] * modules[2];
+	static_assert(moduleCount % DriverCount == 0, "Every driver must have a chain of the same length");
 
-	std::array<DriverMapping, 512> mappings;
+	constexpr size_t chainLength = moduleCount / DriverCount;
+	static_assert(chainLength <= Driver::MaxChainLength, "Too many modules for the drivers");
 
-	for (size_t i = 0; i < 512; ++i)
+	std::array<DriverMapping, X * Y * Z> mappings;
+
+	for (size_t i = 0; i < X * Y * Z; ++i)
 	{
-		std::array<size_t, 3> coords = { i % 8, (i / 8) % 8, (i / 64) % 8 };
+		std::array<size_t, 3> coords = { i % X, (i / X) % Y, (i / (X * Y)) % Z };
+
+		size_t module = (coords[0] / moduleSize[0]) +
+		                (coords[1] / moduleSize[1]) * modules[0] +
+		                (coords[2] / moduleSize[2]) * modules[0] * modules[1];
 
-		// Y - [0:3] = driver1, [4:7] = driver2
-		std::reference_wrapper<Driver> driver = drivers[coords[1] < 4 ? 0 : 1];
+		std::reference_wrapper<Driver> driver = drivers[module / chainLength];
+		size_t chip                           = module % chainLength;
 
-		std::array<size_t, 3> driverCoords = { coords[0], coords[1] % 4, coords[2] };
-		size_t localIndex                  = driverCoords[0] + (driverCoords[1] * 8) + (driverCoords[2] * 32);
+		std::array<size_t, 3> driverCoords = { coords[0] % moduleSize[0], coords[1] % moduleSize[1], coords[2] % moduleSize[2] };
+		size_t localIndex                  = driverCoords[0] + (driverCoords[1] * moduleSize[0]) + (driverCoords[2] * moduleSize[0] * moduleSize[1]);
 
-		size_t index = DriverMapping::LocalToDeviceMapping[localIndex];
+		size_t index = chip * Driver::LedCount + DriverMapping::LocalToDeviceMapping[localIndex];
 
 		mappings[i] = DriverMapping(driver, index);
 	}
@@ -95,4 +124,10 @@ constexpr std::array<DriverMapping, 512> CreateDriverMappings(Driver& driver1, D
 	return mappings;
 }
 
+constexpr std::array<DriverMapping, 512> CreateDriverMappings(Driver& driver1, Driver& driver2)
+{
+	// Y - [0:3] = driver1, [4:7] = driver2
+	return CreateDriverMappings<8, 8, 8>(std::array{ std::ref(driver1), std::ref(driver2) });
+}
+
 } // namespace LumiVoxel::Lp5890
\ No newline at end of file
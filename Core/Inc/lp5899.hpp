@@ -13,12 +13,14 @@
 
 #include "gpio_pin.hpp"
 #include "high_precision_counter.hpp"
+#include "memory_pool.hpp"
 
 #include "stm32_includer.h"
 #include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_def.h)
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_spi.h)
 
+#include <array>
 #include <span>
 
 namespace LumiVoxel
@@ -61,11 +63,74 @@ class Lp5899
 		RXFFST   = 0xA, ///< @brief Detail reception FIFO status
 	};
 
+  public:
+	/// @brief Health of the link to the LED driver chain
+	enum struct LinkState : uint8_t
+	{
+		Healthy,    ///< @brief Transfers are forwarded
+		Degraded,   ///< @brief An error was seen, recovery is attempted on the next `ServiceLink`
+		Recovering, ///< @brief Recovery failed, retried with exponential backoff
+		Failsafe,   ///< @brief The device is in FAILSAFE or recovery keeps failing, retried at the longest backoff
+	};
+
+	static constexpr uint32_t InitialBackoff   = 1000;    ///< @brief Delay in microseconds before retrying a failed recovery
+	static constexpr uint32_t MaxBackoff       = 1000000; ///< @brief Longest delay in microseconds between recovery attempts
+	static constexpr uint8_t FailsafeAttempts = 5;       ///< @brief Failed recoveries before the link is considered failsafe
+
+	/// @brief Progress of a forward write running in the background on the SPI interrupt
+	enum struct TransferState : uint8_t
+	{
+		Idle,         ///< @brief No transfer, the blocking calls may use the bus
+		Prepared,     ///< @brief The command is built and waits for `TryStartForwardWrite`
+		Transmitting, ///< @brief The command is being sent
+		Receiving,    ///< @brief The status reply is being read
+	};
+
+	static constexpr size_t MaxTransferWords = 128; ///< @brief Most words forwarded by one background write, an SRAM write to 32 chained drivers takes 97
+	static constexpr size_t MaxInterfaces    = 2;   ///< @brief Number of interfaces that can be initialized, one per LED driver link
+
+  private:
+	/// @brief Buffers of a background write, the SPI transfers them outside of the CPU so they are kept DMA reachable
+	struct TransferBuffers
+	{
+		std::array<uint16_t, 2 + MaxTransferWords> Send; ///< @brief The command, its data and CRC
+		std::array<uint16_t, 2> Recv;                    ///< @brief The status reply
+	};
+
+	/// @brief Transfer buffers of the initialized interfaces, in non-cacheable D2 SRAM
+	static DmaPool<TransferBuffers, MaxInterfaces> transferPool;
+
 	SPI_HandleTypeDef* const spi; ///< @brief Pointer to the SPI handle
 	GpioPin csPin;                ///< @brief Chip select pin for the SPI interface
 
 	bool initialized = false;
 
+	HighPrecisionCounter* counter = nullptr;
+
+	LinkState linkState      = LinkState::Healthy;
+	uint8_t failedRecoveries = 0;     ///< @brief Failed recoveries since the link was last healthy
+	uint32_t backoff         = 0;     ///< @brief Current delay in microseconds between recovery attempts
+	uint64_t retryTime       = 0;     ///< @brief Time of the next recovery attempt
+	bool resyncPending       = false; ///< @brief Whether the link recovered and the device chain must be sent its state again
+	uint32_t recoveryCount   = 0;     ///< @brief Number of successful recoveries
+
+	/// @brief Stop forwarding transfers until the link is recovered, called instead of recovering on the transfer path
+	void ReportLinkError();
+
+	static constexpr uint16_t UnknownTxFifoLevel = UINT16_MAX;
+	uint16_t txFifoLevel = UnknownTxFifoLevel; ///< @brief TX FIFO level last written, so writes without CRC only set it on change
+
+	uint32_t crcErrorCount  = 0; ///< @brief Number of CRC mismatches on replies from the device
+	uint32_t ccsiErrorCount = 0; ///< @brief Number of CCSI errors reported by the device
+
+	TransferState transferState = TransferState::Idle;
+	bool transferCheckCrc       = false;   ///< @brief Whether the reply of the background write is CRC checked
+	uint16_t transferWords      = 0;       ///< @brief Words sent by the background write, including the command and CRC
+	TransferBuffers* transfer   = nullptr; ///< @brief Buffers of the background write, taken from `transferPool` on `Init`
+
+	/// @brief Check the status reply of a forward command for CRC mismatches and CCSI errors
+	bool TryCheckForwardReply(std::span<uint16_t> recvData, bool checkCrc);
+
 	static constexpr std::array<uint16_t, 256> ccittFalseCrcTable = []() {
 		std::array<uint16_t, 256> table = { 0 };
 
@@ -260,6 +325,12 @@ class Lp5899
 
 	static constexpr uint16_t DEVICE_ID = 0xED99; ///< @brief Device ID for LP5899
 
+	/// @brief CCSI data rate in bits per second of each `CcsiControl::CcsiDataRate` setting, the SCLK of the LED drivers
+	static constexpr std::array<uint32_t, 16> CcsiDataRates = {
+		1000000, 1250000, 1430000, 1670000, 2000000, 2220000, 2500000, 2860000,
+		3330000, 4000000, 5000000, 6670000, 8000000, 10000000, 13330000, 20000000
+	};
+
 	/**
 	 * @brief Construct a new Lp5899 object
 	 *
@@ -289,6 +360,59 @@ class Lp5899
 
 	bool TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t> rxData, size_t extraEndBytes = 0, bool bufferData = true, bool checkCrc = true);
 
+	/**
+	 * @brief Build a forward write to run in the background, the bus is not touched until `TryStartForwardWrite`
+	 * @remark Splitting the build from the start lets transfers on several interfaces start back to back. The SPI
+	 * interrupt of the interface must be enabled and call `HAL_SPI_IRQHandler`.
+	 *
+	 * @param data The data to forward, at most `MaxTransferWords` words
+	 * @param bufferData Whether to buffer the data in the TX FIFO before forwarding
+	 * @param checkCrc Whether to check the CRC of the return data
+	 * @return bool true if the write was prepared, false otherwise
+	 */
+	bool TryPrepareForwardWrite(std::span<const uint16_t> data, bool bufferData = true, bool checkCrc = true);
+
+	/**
+	 * @brief Start sending the prepared forward write and return without waiting for it
+	 *
+	 * @return bool true if the transfer was started, false otherwise
+	 */
+	bool TryStartForwardWrite();
+
+	/**
+	 * @brief Advance the background forward write without blocking, reading the reply once the command is sent
+	 * @remark Call until `IsTransferActive` is false, the reply is checked the same way as `TryForwardWriteData`
+	 *
+	 * @return bool false if the transfer failed, true while it runs and once it completes successfully
+	 */
+	bool TryServiceForwardWrite();
+
+	/**
+	 * @brief Whether a background forward write is prepared or running, the blocking calls fail until it completes
+	 */
+	bool IsTransferActive() const { return transferState != TransferState::Idle; }
+
+	/**
+	 * @brief Forward a read command to the device chain without waiting for the reply
+	 * @remark The reply is collected into the RX FIFO, read it with `TryReadData` once the chain has had time to return it
+	 *
+	 * @param txData The read command to forward
+	 * @param extraEndBytes The number of extra END bytes sent after the command
+	 * @param bufferData Whether to buffer the data in the TX FIFO before forwarding
+	 * @param checkCrc Whether to check the CRC of the return data
+	 * @return bool true if the command was forwarded successfully, false otherwise
+	 */
+	bool TryForwardReadRequest(std::span<uint16_t> txData, size_t extraEndBytes = 0, bool bufferData = true, bool checkCrc = true);
+
+	/**
+	 * @brief Read data returned by the device chain from the RX FIFO
+	 *
+	 * @param rxData The buffer the data is read into, its size is the number of words read
+	 * @param checkCrc Whether to check the CRC of the return data
+	 * @return bool true if the data was read successfully, false otherwise
+	 */
+	bool TryReadData(std::span<uint16_t> rxData, bool checkCrc = true);
+
 	bool TryReadRegister(RegisterAddr reg, uint16_t& value, bool crc = false);
 	// bool TryReadRegisterMultiple(RegisterAddr startAddr, size_t count, std::span<uint16_t> values, bool crc = false);
 	bool TryWriteRegister(RegisterAddr reg, uint16_t value, bool crc = false);
@@ -303,7 +427,17 @@ class Lp5899
 	bool TryWriteCcsiControl(CcsiControl ccsiControl, bool crc = false) { return TryWriteRegister(RegisterAddr::CCSICTRL, ccsiControl.Value, crc); }
 
 	bool TryReadTxFifoControl(TxFifoControl& txFifoControl, bool crc = false) { return TryReadRegister(RegisterAddr::TXFFLVL, txFifoControl.Value, crc); }
-	bool TryWriteTxFifoControl(TxFifoControl txFifoControl, bool crc = false) { return TryWriteRegister(RegisterAddr::TXFFLVL, txFifoControl.Value, crc); }
+	bool TryWriteTxFifoControl(TxFifoControl txFifoControl, bool crc = false)
+	{
+		txFifoLevel = UnknownTxFifoLevel;
+		if (!TryWriteRegister(RegisterAddr::TXFFLVL, txFifoControl.Value, crc))
+			return false;
+
+		if (txFifoControl.TxFifoClear == 0)
+			txFifoLevel = txFifoControl.TxFifoLevel;
+
+		return true;
+	}
 
 	bool TryReadRxFifoControl(RxFifoControl& rxFifoControl, bool crc = false) { return TryReadRegister(RegisterAddr::RXFFLVL, rxFifoControl.Value, crc); }
 	bool TryWriteRxFifoControl(RxFifoControl rxFifoControl, bool crc = false) { return TryWriteRegister(RegisterAddr::RXFFLVL, rxFifoControl.Value, crc); }
@@ -322,6 +456,58 @@ class Lp5899
 	bool TryReadReceptionFifoStatus(ReceptionFifoStatus& receptionFifoStatus, bool crc = false) { return TryReadRegister(RegisterAddr::RXFFST, receptionFifoStatus.Value, crc); }
 
 	bool TrySoftReset();
+
+	/**
+	 * @brief Get the health of the link to the device chain
+	 */
+	LinkState GetLinkState() const { return linkState; }
+
+	/**
+	 * @brief Whether transfers are forwarded to the device chain
+	 */
+	bool IsLinkHealthy() const { return linkState == LinkState::Healthy; }
+
+	/**
+	 * @brief Attempt recovery of an unhealthy link once its backoff has expired
+	 * @remark Call once per frame outside the transfer path
+	 */
+	void ServiceLink();
+
+	/**
+	 * @brief Attempt recovery of the link now, exiting FAILSAFE and clearing the status flags
+	 * @remark On failure the next attempt of `ServiceLink` is delayed by a backoff that doubles up to `MaxBackoff`, a
+	 * failsafe link waits `MaxBackoff` straight away
+	 *
+	 * @return bool true if the device reports a normal state with no errors
+	 */
+	bool TryRecoverLink();
+
+	/**
+	 * @brief Take the request to send the configuration and data of the device chain again after a recovery
+	 *
+	 * @return bool true once after each recovery
+	 */
+	bool TakeResyncRequest()
+	{
+		bool pending  = resyncPending;
+		resyncPending = false;
+		return pending;
+	}
+
+	/**
+	 * @brief Get the number of successful link recoveries
+	 */
+	uint32_t GetRecoveryCount() const { return recoveryCount; }
+
+	/**
+	 * @brief Get the number of CRC mismatches on replies from the device
+	 */
+	uint32_t GetCrcErrorCount() const { return crcErrorCount; }
+
+	/**
+	 * @brief Get the number of CCSI errors reported by the device
+	 */
+	uint32_t GetCcsiErrorCount() const { return ccsiErrorCount; }
 }; // class Lp5899
 
 } // namespace LumiVoxel
@@ -0,0 +1,149 @@
+/**
+ * @file telemetry.hpp
+ * @author Aidan Orr
+ * @brief Frame timing and error statistics reported over BLE
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+#pragma once
+
+#include "high_precision_counter.hpp"
+
+#include <array>
+#include <cstdint>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Accumulates per-frame stage timings over a sampling window and packs them with error counters into a compact packet
+ */
+class Telemetry
+{
+  public:
+	static constexpr uint8_t PacketVersion = 2;
+
+	/// @brief Stages of a display update that are timed individually
+	enum struct Stage : uint8_t
+	{
+		Map,         ///< @brief Mapping voxel colors to driver LEDs
+		WriteColors, ///< @brief Writing the SRAM data to the drivers
+		Vsync,       ///< @brief Sending VSYNC to the drivers
+		Count,
+	};
+
+	static constexpr size_t StageCount = static_cast<size_t>(Stage::Count);
+
+	/**
+	 * @brief Telemetry notification payload, little-endian
+	 * @remark Sized to fit the 20 byte notification payload of the default ATT MTU
+	 */
+	struct __attribute__((packed)) Packet
+	{
+		uint8_t Version;                             ///< @brief Packet layout version, `PacketVersion`
+		uint8_t BleQueueDepth;                       ///< @brief Number of BLE notifications waiting to be sent
+		uint16_t FrameRate;                          ///< @brief Achieved frame rate in units of 0.1 Hz
+		std::array<uint16_t, StageCount> StageTimes; ///< @brief Average time of each stage in microseconds
+		uint16_t CrcErrors;                          ///< @brief Total LP5899 CRC errors, saturating
+		uint16_t CcsiErrors;                         ///< @brief Total LP5899 CCSI errors, saturating
+		uint32_t HeapHighWater;                      ///< @brief Peak heap size in bytes
+		uint16_t MissedDeadlines;                    ///< @brief Total frames that started late or were skipped, saturating
+	};
+
+	static_assert(sizeof(Packet) <= 20, "Telemetry packet must fit in a single notification");
+
+  private:
+	HighPrecisionCounter& counter;
+
+	uint64_t windowStart = 0; ///< @brief Start of the current sampling window
+	uint64_t stageStart  = 0; ///< @brief Start of the current stage
+
+	uint32_t frameCount                          = 0;     ///< @brief Frames completed in the current window
+	std::array<uint32_t, StageCount> stageTotals = { 0 }; ///< @brief Accumulated stage times in the current window
+
+	uint32_t cycleStart                          = 0;     ///< @brief Cycle count at the start of the current stage
+	uint32_t cycleFrameCount                     = 0;     ///< @brief Frames completed in the current cycle profile window
+	std::array<uint64_t, StageCount> stageCycles = { 0 }; ///< @brief Accumulated stage cycles in the current cycle profile window
+
+	static constexpr uint16_t Saturate(uint64_t value)
+	{
+		return value > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(value);
+	}
+
+  public:
+	/**
+	 * @brief Construct a new Telemetry object
+	 *
+	 * @param counter The counter used to time the frame stages
+	 */
+	constexpr Telemetry(HighPrecisionCounter& counter)
+		: counter(counter)
+	{}
+
+	/**
+	 * @brief Enable the DWT cycle counter used for the cycle profile
+	 */
+	static void EnableCycleCounter()
+	{
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->LAR    = 0xC5ACCE55; // The Cortex-M7 DWT is locked after reset
+		DWT->CYCCNT = 0;
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+	}
+
+	/**
+	 * @brief Mark the start of a frame
+	 */
+	void BeginFrame()
+	{
+		stageStart = counter.GetCount();
+		cycleStart = DWT->CYCCNT;
+	}
+
+	/**
+	 * @brief Mark the end of a stage, the next stage starts immediately
+	 *
+	 * @param stage The stage that just completed
+	 */
+	void EndStage(Stage stage)
+	{
+		uint64_t now = counter.GetCount();
+		stageTotals[static_cast<size_t>(stage)] += static_cast<uint32_t>(now - stageStart);
+		stageStart = now;
+
+		uint32_t cycles = DWT->CYCCNT;
+		stageCycles[static_cast<size_t>(stage)] += cycles - cycleStart;
+		cycleStart = cycles;
+	}
+
+	/**
+	 * @brief Mark the end of a frame
+	 */
+	void EndFrame()
+	{
+		frameCount++;
+		cycleFrameCount++;
+	}
+
+	/**
+	 * @brief Pack the statistics of the current window and start a new window
+	 *
+	 * @param crcErrors Total CRC errors across all interfaces
+	 * @param ccsiErrors Total CCSI errors across all interfaces
+	 * @param bleQueueDepth Number of BLE notifications waiting to be sent
+	 * @param missedDeadlines Total frame deadlines missed by the render loop
+	 * @return `Packet` The telemetry packet
+	 */
+	Packet Sample(uint32_t crcErrors, uint32_t ccsiErrors, uint8_t bleQueueDepth, uint32_t missedDeadlines);
+
+	/**
+	 * @brief Get the average CPU cycles of each stage per frame since the last call and start a new cycle profile window
+	 * @remark Cycles are counted independently of the telemetry window, so both can be sampled at different rates
+	 *
+	 * @return `std::array<uint32_t, StageCount>` The average cycles of each stage per frame
+	 */
+	std::array<uint32_t, StageCount> SampleCycles();
+};
+
+} // namespace LumiVoxel
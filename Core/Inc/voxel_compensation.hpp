@@ -0,0 +1,185 @@
+/**
+ * @file voxel_compensation.hpp
+ * @author Aidan Orr
+ * @brief Compensation of failed LED channels by their neighbouring voxels
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+#pragma once
+
+#include "lp5890/diagnostics.hpp"
+#include "voxel_health.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Redistributes the intensity of failed LED channels to the same channel of their 6-connected neighbours
+ * @remark Failed channels are driven dark, and their intensity is split evenly between the neighbours whose channel is
+ * healthy. Only the failed voxels and their neighbours are visited, so the cost scales with the number of failed voxels.
+ * The rendered colors are left untouched, the compensated colors are applied while mapping with `Adjust`.
+ *
+ * @tparam XSize The number of voxels along x
+ * @tparam YSize The number of voxels along y
+ * @tparam ZSize The number of voxels along z
+ */
+template <size_t XSize, size_t YSize, size_t ZSize>
+class VoxelCompensation
+{
+  public:
+	static constexpr size_t VoxelCount = XSize * YSize * ZSize;
+
+  private:
+	static constexpr size_t ChannelCount = 3;
+
+	/// @brief Fault flags that make each channel unusable
+	static constexpr std::array<uint8_t, ChannelCount> ChannelFaults = {
+		Lp5890::Diagnostics::RedOpen | Lp5890::Diagnostics::RedShort,
+		Lp5890::Diagnostics::GreenOpen | Lp5890::Diagnostics::GreenShort,
+		Lp5890::Diagnostics::BlueOpen | Lp5890::Diagnostics::BlueShort,
+	};
+
+	std::array<std::array<float, ChannelCount>, VoxelCount> adjusted; ///< @brief Compensated colors of the adjusted voxels
+	std::array<bool, VoxelCount> isAdjusted;                         ///< @brief Whether each voxel has a compensated color
+	std::array<uint16_t, VoxelCount> adjustedVoxels;                 ///< @brief The adjusted voxels, the first `adjustedCount` are valid
+	size_t adjustedCount = 0;
+
+	/**
+	 * @brief Start adjusting a voxel from its rendered color with its failed channels dark
+	 */
+	void Touch(size_t voxel, uint8_t faults, const std::array<float, ChannelCount>& color)
+	{
+		if (isAdjusted[voxel])
+			return;
+
+		for (size_t channel = 0; channel < ChannelCount; channel++)
+			adjusted[voxel][channel] = (faults & ChannelFaults[channel]) ? 0.0f : color[channel];
+
+		isAdjusted[voxel]               = true;
+		adjustedVoxels[adjustedCount++] = static_cast<uint16_t>(voxel);
+	}
+
+	/**
+	 * @brief Get the 6-connected neighbours of a voxel that are inside the cube
+	 *
+	 * @return `size_t` The number of neighbours written to `neighbours`
+	 */
+	static size_t GetNeighbours(size_t voxel, std::array<uint16_t, 6>& neighbours)
+	{
+		size_t x = voxel % XSize;
+		size_t y = (voxel / XSize) % YSize;
+		size_t z = voxel / (XSize * YSize);
+
+		size_t count = 0;
+		if (x > 0)
+			neighbours[count++] = static_cast<uint16_t>(voxel - 1);
+		if (x + 1 < XSize)
+			neighbours[count++] = static_cast<uint16_t>(voxel + 1);
+		if (y > 0)
+			neighbours[count++] = static_cast<uint16_t>(voxel - XSize);
+		if (y + 1 < YSize)
+			neighbours[count++] = static_cast<uint16_t>(voxel + XSize);
+		if (z > 0)
+			neighbours[count++] = static_cast<uint16_t>(voxel - XSize * YSize);
+		if (z + 1 < ZSize)
+			neighbours[count++] = static_cast<uint16_t>(voxel + XSize * YSize);
+
+		return count;
+	}
+
+  public:
+	constexpr VoxelCompensation()
+	{
+		isAdjusted.fill(false);
+		adjustedVoxels.fill(0);
+	}
+
+	/**
+	 * @brief Compute the compensated colors for the current frame
+	 *
+	 * @param health The faults of each voxel
+	 * @param red The rendered red channel
+	 * @param green The rendered green channel
+	 * @param blue The rendered blue channel
+	 */
+	void Update(const VoxelHealth<VoxelCount>& health, const std::array<float, VoxelCount>& red,
+	            const std::array<float, VoxelCount>& green, const std::array<float, VoxelCount>& blue)
+	{
+		for (size_t i = 0; i < adjustedCount; i++)
+			isAdjusted[adjustedVoxels[i]] = false;
+		adjustedCount = 0;
+
+		auto colorOf = [&](size_t voxel) { return std::array<float, ChannelCount>{ red[voxel], green[voxel], blue[voxel] }; };
+
+		std::span<const uint16_t> failed = health.GetFailedVoxels();
+
+		// All failed voxels are darkened first so neighbours that also failed keep their share
+		for (uint16_t voxel : failed)
+			Touch(voxel, health.GetFaults(voxel), colorOf(voxel));
+
+		for (uint16_t voxel : failed)
+		{
+			uint8_t faults                        = health.GetFaults(voxel);
+			std::array<float, ChannelCount> color = colorOf(voxel);
+			std::array<uint16_t, 6> neighbours;
+			size_t neighbourCount = GetNeighbours(voxel, neighbours);
+
+			for (size_t channel = 0; channel < ChannelCount; channel++)
+			{
+				if ((faults & ChannelFaults[channel]) == 0 || color[channel] <= 0.0f)
+					continue;
+
+				std::array<uint16_t, 6> healthy;
+				size_t healthyCount = 0;
+				for (size_t i = 0; i < neighbourCount; i++)
+				{
+					if ((health.GetFaults(neighbours[i]) & ChannelFaults[channel]) == 0)
+						healthy[healthyCount++] = neighbours[i];
+				}
+
+				if (healthyCount == 0)
+					continue;
+
+				float share = color[channel] / healthyCount;
+				for (size_t i = 0; i < healthyCount; i++)
+				{
+					uint16_t neighbour = healthy[i];
+					Touch(neighbour, health.GetFaults(neighbour), colorOf(neighbour));
+					adjusted[neighbour][channel] += share;
+				}
+			}
+		}
+	}
+
+	/**
+	 * @brief Replace a rendered color with its compensated color if the voxel is adjusted this frame
+	 *
+	 * @param voxel The voxel index
+	 * @param red The red channel, replaced if adjusted
+	 * @param green The green channel, replaced if adjusted
+	 * @param blue The blue channel, replaced if adjusted
+	 */
+	void Adjust(size_t voxel, float& red, float& green, float& blue) const
+	{
+		if (!isAdjusted[voxel])
+			return;
+
+		red   = std::min(adjusted[voxel][0], 1.0f);
+		green = std::min(adjusted[voxel][1], 1.0f);
+		blue  = std::min(adjusted[voxel][2], 1.0f);
+	}
+
+	/**
+	 * @brief Get the number of voxels whose color is compensated this frame
+	 */
+	size_t GetAdjustedCount() const { return adjustedCount; }
+};
+
+} // namespace LumiVoxel
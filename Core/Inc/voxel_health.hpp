@@ -0,0 +1,134 @@
+/**
+ * @file voxel_health.hpp
+ * @author Aidan Orr
+ * @brief Per-voxel LED fault map
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Fault flags of each voxel, with a compact list of the failed voxels so they can be visited without scanning
+ * every voxel
+ *
+ * @tparam VoxelCount The number of voxels
+ */
+template <size_t VoxelCount>
+class VoxelHealth
+{
+	static_assert(VoxelCount <= 512, "Voxel indices are packed into 9 bits");
+
+  public:
+	/// @brief Marker in the first byte of a packet, distinct from the telemetry packet versions
+	static constexpr uint8_t PacketType = 0x80;
+	/// @brief Number of failed voxels in each packet
+	static constexpr size_t PacketEntries = 8;
+
+	/**
+	 * @brief Failed voxel notification payload, little-endian
+	 * @remark Sized to fit the 20 byte notification payload of the default ATT MTU. Each entry is a voxel index in bits
+	 * 0-8 and its fault flags in bits 9-14.
+	 */
+	struct __attribute__((packed)) Packet
+	{
+		uint8_t Type;                                ///< @brief Always `PacketType`
+		uint8_t FailedCount;                         ///< @brief Total failed voxels, saturating
+		uint8_t Page;                                ///< @brief Page of the failed voxel list in this packet, `PacketEntries` entries per page
+		uint8_t EntryCount;                          ///< @brief Number of valid entries
+		std::array<uint16_t, PacketEntries> Entries; ///< @brief Failed voxels and their fault flags
+	};
+
+	static_assert(sizeof(Packet) <= 20, "Voxel health packet must fit in a single notification");
+
+  private:
+	static constexpr uint16_t NotFailed = UINT16_MAX;
+
+	std::array<uint8_t, VoxelCount> faults;
+	std::array<uint16_t, VoxelCount> failed;   ///< @brief Indices of the failed voxels, the first `failedCount` are valid
+	std::array<uint16_t, VoxelCount> position; ///< @brief Position of each voxel in `failed`, `NotFailed` if healthy
+	size_t failedCount = 0;
+
+  public:
+	constexpr VoxelHealth()
+	{
+		faults.fill(0);
+		failed.fill(0);
+		position.fill(NotFailed);
+	}
+
+	/**
+	 * @brief Set the fault flags of a voxel
+	 *
+	 * @param voxel The voxel index
+	 * @param flags The fault flags, zero for a healthy voxel
+	 */
+	void SetFaults(size_t voxel, uint8_t flags)
+	{
+		if (voxel >= VoxelCount)
+			return;
+
+		faults[voxel] = flags;
+
+		if (flags != 0 && position[voxel] == NotFailed)
+		{
+			position[voxel]       = static_cast<uint16_t>(failedCount);
+			failed[failedCount++] = static_cast<uint16_t>(voxel);
+		}
+		else if (flags == 0 && position[voxel] != NotFailed)
+		{
+			// Move the last failed voxel into the removed voxel's place
+			uint16_t last           = failed[--failedCount];
+			failed[position[voxel]] = last;
+			position[last]          = position[voxel];
+			position[voxel]         = NotFailed;
+		}
+	}
+
+	/**
+	 * @brief Get the fault flags of a voxel
+	 */
+	uint8_t GetFaults(size_t voxel) const { return voxel < VoxelCount ? faults[voxel] : 0; }
+
+	/**
+	 * @brief Get the number of pages needed to send the failed voxel list
+	 */
+	size_t GetPageCount() const { return (failedCount + PacketEntries - 1) / PacketEntries; }
+
+	/**
+	 * @brief Get the indices of the failed voxels, in no particular order
+	 */
+	std::span<const uint16_t> GetFailedVoxels() const { return std::span(failed.data(), failedCount); }
+
+	/**
+	 * @brief Pack a page of the failed voxel list
+	 *
+	 * @param page The page, `PacketEntries` entries per page
+	 * @return `Packet` The packet, with no entries when the page is past the end of the list
+	 */
+	Packet Pack(size_t page) const
+	{
+		Packet packet      = {};
+		packet.Type        = PacketType;
+		packet.FailedCount = static_cast<uint8_t>(failedCount > UINT8_MAX ? UINT8_MAX : failedCount);
+		packet.Page        = static_cast<uint8_t>(page);
+
+		for (size_t i = page * PacketEntries; i < failedCount && packet.EntryCount < PacketEntries; i++)
+		{
+			uint16_t voxel                      = failed[i];
+			packet.Entries[packet.EntryCount++] = static_cast<uint16_t>(voxel | (faults[voxel] << 9));
+		}
+
+		return packet;
+	}
+};
+
+} // namespace LumiVoxel
@@ -0,0 +1,59 @@
+/**
+ * @file frame_pacer.cpp
+ * @author Aidan Orr
+ * @brief Fixed rate frame pacing of the render loop
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "frame_pacer.hpp"
+
+#include "binary_log.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace LumiVoxel;
+
+uint32_t FramePacer::Configure(float frameRate, uint32_t displayPeriod, uint32_t renderBudget, uint32_t transmitBudget)
+{
+	displayPeriod = std::max<uint32_t>(displayPeriod, 1);
+
+	// A frame spans whole display periods so VSYNC always lands at the end of a complete PWM cycle
+	float targetPeriod    = frameRate > 0.0f ? 1000000.0f / frameRate : displayPeriod;
+	uint32_t periodsCount = std::max<uint32_t>(static_cast<uint32_t>(std::lround(targetPeriod / displayPeriod)), 1);
+
+	framePeriod = periodsCount * displayPeriod;
+	budgets     = { renderBudget, transmitBudget };
+	overruns.fill(0);
+
+	missedDeadlines  = 0;
+	skippedTransmits = 0;
+
+	phaseStart = counter.GetCount();
+	frameStart = phaseStart - framePeriod;
+
+	return framePeriod;
+}
+
+void FramePacer::BeginFrame()
+{
+	uint64_t now      = counter.GetCount();
+	uint64_t boundary = GetFrameDeadline();
+
+	if (now > boundary + MaxLateness)
+	{
+		// Boundaries passed entirely are skipped, the frame stays on the grid so VSYNC keeps the same phase
+		uint64_t late    = now - boundary;
+		uint64_t skipped = late / framePeriod;
+		boundary += skipped * framePeriod;
+
+		missedDeadlines += static_cast<uint32_t>(skipped) + (now > boundary + MaxLateness ? 1 : 0);
+
+		LOG_BINARY("Frame deadline missed: %lu us late, %lu frames skipped", static_cast<uint32_t>(late), static_cast<uint32_t>(skipped));
+	}
+
+	frameStart = boundary;
+	phaseStart = now;
+}
@@ -1,5 +1,6 @@
 #include "lp5890.hpp"
 
+#include "binary_log.hpp"
 #include "errors.hpp"
 #include "lp5890/registers.hpp"
 
@@ -13,6 +14,18 @@ bool Driver::Init(HighPrecisionCounter& hpc)
 	if (initialized)
 		return true;
 
+	if (chainLength == 0 || chainLength > MaxChainLength || colors.size() != chainLength * LedCount)
+	{
+		ErrorMessage::SetMessage("LP5890 - Initialization failed: Color storage of %u LEDs is not a chain of whole chips", colors.size());
+		return false;
+	}
+
+	if (fc0Config.ChipNumber + 1u != chainLength)
+	{
+		ErrorMessage::SetMessage("LP5890 - Initialization failed: FC0 chip number %u does not match a chain of %u chips", fc0Config.ChipNumber, chainLength);
+		return false;
+	}
+
 	// Initialize the LP5899 driver
 	if (!interface.Init(hpc))
 	{
@@ -21,7 +34,7 @@ bool Driver::Init(HighPrecisionCounter& hpc)
 	}
 
 	Lp5899::CcsiControl ccsiControl{
-		.CcsiDataRate       = CcsiClock,
+		.CcsiDataRate       = ccsiDataRate,
 		.CcsiSpreadSpectrum = 0
 	};
 
@@ -72,6 +85,7 @@ bool Driver::Init(HighPrecisionCounter& hpc)
 		return false;
 	}
 
+	// Each chip takes the index after the one before it, so a single command numbers the whole chain
 	puts("LP5890 - Fowarding Chip Index command...");
 	std::array<uint16_t, 1> chipIndex = { static_cast<uint16_t>(Command::CHIP_INDEX_WRITE) };
 	if (!interface.TryForwardWriteData(chipIndex, true, true))
@@ -82,72 +96,226 @@ bool Driver::Init(HighPrecisionCounter& hpc)
 
 	puts("LP5890 - Writing LED driver configuration registers...");
 
-	puts("LP5890 - Forwarding FC0 register...");
-	std::array<uint16_t, 4> fc0 = { static_cast<uint16_t>(Command::FC0_WRITE), fc0Config.Value[2], fc0Config.Value[1], fc0Config.Value[0] };
-	if (!interface.TryForwardWriteData(fc0, true, true))
+	for (size_t i = 0; i < ConfigRegisterCount; i++)
 	{
-		ErrorMessage::WrapMessage("LP5890 - Initialization failed: LP5890 FC0 register write failed");
-		return false;
+		printf("LP5890 - Forwarding FC%u register...\n", i);
+		if (!TryForwardRegister(ConfigCommands[i], *configValues[i]))
+		{
+			ErrorMessage::WrapMessage("LP5890 - Initialization failed: LP5890 FC%u register write failed", i);
+			return false;
+		}
 	}
 
-	puts("LP5890 - Forwarding FC1 register...");
-	std::array<uint16_t, 4> fc1 = { static_cast<uint16_t>(Command::FC1_WRITE), fc1Config.Value[2], fc1Config.Value[1], fc1Config.Value[0] };
-	if (!interface.TryForwardWriteData(fc1, true, true))
-	{
-		ErrorMessage::WrapMessage("LP5890 - Initialization failed: LP5890 FC1 register write failed");
+	for (size_t i = 0; i < ConfigRegisterCount; i++)
+		writtenConfig[i] = *configValues[i];
+
+	initialized = true;
+
+	return true;
+}
+
+uint32_t Driver::GetDisplayPeriod() const
+{
+	uint32_t gclkFrequency = Lp5899::CcsiDataRates[ccsiDataRate] * (fc0Config.FrequencyMultiplier + 1);
+	uint32_t scanLines     = fc0Config.ScanLineNumber + 1;
+	uint32_t subPeriods    = 16 * (fc0Config.SubPeriodNumber + 1);
+	uint32_t segmentLength = std::max<uint32_t>(fc1Config.SegmentLength + 1, 128);
+	uint32_t lineSwitch    = fc1Config.ScanLineSwitchTime == 0 ? 45 : 30 * (fc1Config.ScanLineSwitchTime + 1);
+
+	uint64_t gclkCount = static_cast<uint64_t>(subPeriods) * scanLines * (segmentLength + lineSwitch);
+	return static_cast<uint32_t>(gclkCount * 1000000 / gclkFrequency);
+}
+
+bool Driver::TryWriteColors()
+{
+	if (!TryBeginWriteColors())
 		return false;
-	}
 
-	puts("LP5890 - Forwarding FC2 register...");
-	std::array<uint16_t, 4> fc2 = { static_cast<uint16_t>(Command::FC2_WRITE), fc2Config.Value[2], fc2Config.Value[1], fc2Config.Value[0] };
-	if (!interface.TryForwardWriteData(fc2, true, true))
+	while (IsWritingColors())
 	{
-		ErrorMessage::WrapMessage("LP5890 - Initialization failed: LP5890 FC2 register write failed");
-		return false;
+		if (!TryServiceWriteColors())
+			return false;
 	}
 
-	puts("LP5890 - Forwarding FC3 register...");
-	std::array<uint16_t, 4> fc3 = { static_cast<uint16_t>(Command::FC3_WRITE), fc3Config.Value[2], fc3Config.Value[1], fc3Config.Value[0] };
-	if (!interface.TryForwardWriteData(fc3, true, true))
+	return !statusPollPending || TryPollStatus();
+}
+
+bool Driver::TryBeginWriteColors()
+{
+	if (!initialized)
 	{
-		ErrorMessage::WrapMessage("LP5890 - Initialization failed: LP5890 FC3 register write failed");
+		ErrorMessage::SetMessage("LP5890 - Write Colors failed: Not initialized");
 		return false;
 	}
 
-	puts("LP5890 - Forwarding FC4 register...");
-	std::array<uint16_t, 4> fc4 = { static_cast<uint16_t>(Command::FC4_WRITE), fc4Config.Value[2], fc4Config.Value[1], fc4Config.Value[0] };
-	if (!interface.TryForwardWriteData(fc4, true, true))
+	if (writing)
 	{
-		ErrorMessage::WrapMessage("LP5890 - Initialization failed: LP5890 FC4 register write failed");
+		ErrorMessage::SetMessage("LP5890 - Write Colors failed: Write already in progress");
 		return false;
 	}
 
-	initialized = true;
+	// The SRAM is overwritten from here on, so the previous write can no longer be latched
+	latchPending      = false;
+	statusPollPending = false;
+	writing           = true;
+	writeIndex        = 0;
+	writeFullCrc      = IsFullCrc();
+	writeInterval     = std::max<uint16_t>(integrityPolicy.SampleInterval, 1);
 
 	return true;
 }
 
-bool Driver::TryWriteColors()
+bool Driver::TryServiceWriteColors()
 {
-	if (!initialized)
+	if (!writing)
+		return true;
+
+	if (!interface.TryServiceForwardWrite())
 	{
-		ErrorMessage::SetMessage("LP5890 - Write Colors failed: Not initialized");
+		AbortWriteColors();
+		ErrorMessage::WrapMessage("LP5890 - Write Colors failed: LP5890 SRAM write failed");
 		return false;
 	}
 
-	for (size_t i = 0; i < LedCount; ++i)
+	if (interface.IsTransferActive())
+		return true;
+
+	if (writeIndex < LedCount)
 	{
-		std::array<uint16_t, 4> writeSram = { static_cast<uint16_t>(Command::SRAM_WRITE), blue[i], green[i], red[i] };
-		if (!interface.TryForwardWriteData(writeSram, false, true))
+		size_t i      = writeIndex++;
+		bool checkCrc = writeFullCrc || i % writeInterval == sampleOffset;
+
+		// One command carries LED i of every chip in the chain
+		std::array<uint16_t, 1 + 3 * MaxChainLength> writeSram;
+		writeSram[0] = static_cast<uint16_t>(Command::SRAM_WRITE);
+		for (size_t chip = 0; chip < chainLength; chip++)
+		{
+			const Color& color = colors[chip * LedCount + i];
+			size_t slot        = 1 + 3 * GetChainSlot(chip);
+
+			writeSram[slot]     = color.Blue;
+			writeSram[slot + 1] = color.Green;
+			writeSram[slot + 2] = color.Red;
+		}
+
+		std::span<const uint16_t> write = std::span(writeSram).first(1 + 3 * chainLength);
+		if (!interface.TryPrepareForwardWrite(write, false, checkCrc) || !interface.TryStartForwardWrite())
 		{
+			AbortWriteColors();
 			ErrorMessage::WrapMessage("LP5890 - Write Colors failed: LP5890 SRAM write failed");
 			return false;
 		}
+
+		return true;
+	}
+
+	writing = false;
+	return TryFinishWriteColors();
+}
+
+bool Driver::TryPollStatus()
+{
+	if (!statusPollPending)
+		return true;
+
+	statusPollPending = false;
+
+	Lp5899::GlobalStatus status;
+	status.Value = 0;
+	if (!interface.TryReadGlobalStatus(status, true) || status.GlobalErrorFlag != 0)
+	{
+		interface.TryClearGlobalStatus(true);
+		FallBackToFullCrc();
+		ErrorMessage::SetMessage("LP5890 - Write Colors failed: Global status %04X after sampled writes", status.Value);
+		return false;
+	}
+
+	modified     = false;
+	latchPending = true;
+
+	return true;
+}
+
+void Driver::AbortWriteColors()
+{
+	writing = false;
+	FallBackToFullCrc();
+}
+
+bool Driver::TryFinishWriteColors()
+{
+	if (!writeFullCrc)
+	{
+		sampleOffset = (sampleOffset + 1) % writeInterval;
+
+		// Errors on writes without CRC only show up in the global status, which is read once the other links are idle
+		if (++statusFrames >= integrityPolicy.StatusInterval)
+		{
+			statusFrames      = 0;
+			statusPollPending = true;
+			return true;
+		}
+	}
+	else if (fullCrc && ++cleanFrames >= integrityPolicy.RecoveryFrames)
+	{
+		fullCrc = false;
+		LOG_BINARY("LP5890 - Integrity sampling resumed after %u clean frames", cleanFrames);
 	}
 
+	modified     = false;
+	latchPending = true;
+
 	return true;
 }
 
+void Driver::FallBackToFullCrc()
+{
+	if (integrityPolicy.Sampled && !fullCrc)
+	{
+		fallbackCount++;
+		LOG_BINARY("LP5890 - Integrity error, checking the CRC of every write");
+	}
+
+	fullCrc     = true;
+	cleanFrames = 0;
+}
+
+void Driver::Resync()
+{
+	Retransmit((1 << ConfigRegisterCount) - 1);
+}
+
+void Driver::Retransmit(uint8_t config)
+{
+	// Any value that differs from the shadow marks the register dirty
+	for (size_t i = 0; i < ConfigRegisterCount; i++)
+	{
+		if (config & (1 << i))
+			writtenConfig[i][0] = static_cast<uint16_t>(~(*configValues[i])[0]);
+	}
+
+	modified = true;
+}
+
+void Driver::ServiceLink()
+{
+	interface.ServiceLink();
+
+	if (interface.TakeResyncRequest())
+		Resync();
+}
+
+bool Driver::TryRecoverLink()
+{
+	if (!interface.IsLinkHealthy())
+		interface.TryRecoverLink();
+
+	if (interface.TakeResyncRequest())
+		Resync();
+
+	return interface.IsLinkHealthy();
+}
+
 bool Driver::TrySendVsync()
 {
 	if (!initialized)
@@ -165,5 +333,255 @@ bool Driver::TrySendVsync()
 
 	// puts("LP5890 - LP5899 VSYNC command completed successfully");
 
+	latchPending = false;
+	return true;
+}
+
+bool Driver::TryPrepareVsync()
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5890 - VSYNC command failed: Not initialized");
+		return false;
+	}
+
+	std::array<uint16_t, 1> vsync = { static_cast<uint16_t>(Command::VSYNC_WRITE) };
+	if (!interface.TryPrepareForwardWrite(vsync, true, true))
+	{
+		ErrorMessage::WrapMessage("LP5890 - VSYNC command failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool Driver::TryStartVsync()
+{
+	if (!interface.TryStartForwardWrite())
+	{
+		ErrorMessage::WrapMessage("LP5890 - VSYNC command failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool Driver::TryServiceVsync()
+{
+	if (!interface.TryServiceForwardWrite())
+	{
+		ErrorMessage::WrapMessage("LP5890 - VSYNC command failed");
+		return false;
+	}
+
+	if (!interface.IsTransferActive())
+		latchPending = false;
+
+	return true;
+}
+
+bool Driver::TrySetCcsiDataRate(uint8_t rate)
+{
+	if (rate >= Lp5899::CcsiDataRates.size())
+	{
+		ErrorMessage::SetMessage("LP5890 - Set CCSI data rate failed: Invalid rate %u", rate);
+		return false;
+	}
+
+	uint32_t sclk       = Lp5899::CcsiDataRates[rate];
+	uint32_t multiplier = std::clamp<uint32_t>((GclkTarget + sclk / 2) / sclk, 1, 16);
+	uint32_t gclk       = sclk * multiplier;
+
+	fc0Config.FrequencyMultiplier = multiplier - 1;
+	fc0Config.FrequencyMode       = gclk > 80000000 ? 1 : 0;
+
+	if (!initialized)
+	{
+		ccsiDataRate = rate;
+		return true;
+	}
+
+	auto tryWriteRate = [this, rate]() {
+		Lp5899::CcsiControl ccsiControl{
+			.CcsiDataRate       = rate,
+			.CcsiSpreadSpectrum = 0
+		};
+
+		if (!interface.TryWriteCcsiControl(ccsiControl, true))
+		{
+			ErrorMessage::WrapMessage("LP5890 - Set CCSI data rate failed: LP5899 CCSI control write failed");
+			return false;
+		}
+
+		ccsiDataRate = rate;
+		return true;
+	};
+
+	// GCLK only drops while the rate and multiplier disagree
+	if (rate > ccsiDataRate)
+	{
+		if (!TryWriteDirtyConfig())
+		{
+			ErrorMessage::WrapMessage("LP5890 - Set CCSI data rate failed: FC0 write failed");
+			return false;
+		}
+
+		return tryWriteRate();
+	}
+
+	if (!tryWriteRate())
+		return false;
+
+	if (!TryWriteDirtyConfig())
+	{
+		ErrorMessage::WrapMessage("LP5890 - Set CCSI data rate failed: FC0 write failed");
+		return false;
+	}
+
+	return true;
+}
+
+uint8_t Driver::GetDirtyConfig() const
+{
+	uint8_t dirty = 0;
+	for (size_t i = 0; i < ConfigRegisterCount; i++)
+	{
+		if (*configValues[i] != writtenConfig[i])
+			dirty |= 1 << i;
+	}
+
+	return dirty;
+}
+
+bool Driver::TryWriteDirtyConfig()
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5890 - Config write failed: Not initialized");
+		return false;
+	}
+
+	for (size_t i = 0; i < ConfigRegisterCount; i++)
+	{
+		if (*configValues[i] == writtenConfig[i])
+			continue;
+
+		// The shadow only advances once the chip has the value, so a failed register is retried on the next push
+		if (!TryWriteRegister(ConfigCommands[i], *configValues[i]))
+		{
+			ErrorMessage::WrapMessage("LP5890 - Config write failed");
+			return false;
+		}
+
+		writtenConfig[i] = *configValues[i];
+	}
+
+	return true;
+}
+
+bool Driver::TryWriteRegister(Command command, const std::array<uint16_t, 3>& value)
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5890 - Register write failed: Not initialized");
+		return false;
+	}
+
+	return TryForwardRegister(command, value);
+}
+
+bool Driver::TryForwardRegister(Command command, const std::array<uint16_t, 3>& value)
+{
+	// Registers are sent most significant word first, the same value for every chip
+	std::array<uint16_t, 1 + 3 * MaxChainLength> write;
+	write[0] = static_cast<uint16_t>(command);
+	for (size_t slot = 0; slot < chainLength; slot++)
+	{
+		write[1 + 3 * slot]     = value[2];
+		write[1 + 3 * slot + 1] = value[1];
+		write[1 + 3 * slot + 2] = value[0];
+	}
+
+	if (!interface.TryForwardWriteData(std::span(write).first(1 + 3 * chainLength), true, true))
+	{
+		ErrorMessage::WrapMessage("LP5890 - Register write failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool Driver::TryReadRegister(Command command, std::span<std::array<uint16_t, 3>> values)
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5890 - Register read failed: Not initialized");
+		return false;
+	}
+
+	if (values.size() != chainLength)
+	{
+		ErrorMessage::SetMessage("LP5890 - Register read failed: %u values for a chain of %u chips", values.size(), chainLength);
+		return false;
+	}
+
+	std::array<uint16_t, 1> read                   = { static_cast<uint16_t>(command) };
+	std::array<uint16_t, 3 * MaxChainLength> reply = { 0 };
+	if (!interface.TryForwardReadData(read, std::span(reply).first(3 * chainLength), 0, true, true))
+	{
+		ErrorMessage::WrapMessage("LP5890 - Register read failed");
+		return false;
+	}
+
+	// Registers are returned most significant word first, the same order they are written in
+	for (size_t chip = 0; chip < chainLength; chip++)
+	{
+		size_t slot  = 3 * GetChainSlot(chip);
+		values[chip] = { reply[slot + 2], reply[slot + 1], reply[slot] };
+	}
+
+	return true;
+}
+
+bool Driver::TryRequestRegister(Command command)
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5890 - Register read failed: Not initialized");
+		return false;
+	}
+
+	std::array<uint16_t, 1> read = { static_cast<uint16_t>(command) };
+	if (!interface.TryForwardReadRequest(read, 0, true, true))
+	{
+		ErrorMessage::WrapMessage("LP5890 - Register read failed");
+		return false;
+	}
+
+	return true;
+}
+
+bool Driver::TryFetchRegister(std::span<std::array<uint16_t, 3>> values)
+{
+	if (values.size() != chainLength)
+	{
+		ErrorMessage::SetMessage("LP5890 - Register read failed: %u values for a chain of %u chips", values.size(), chainLength);
+		return false;
+	}
+
+	std::array<uint16_t, 3 * MaxChainLength> reply = { 0 };
+	if (!interface.TryReadData(std::span(reply).first(3 * chainLength), true))
+	{
+		ErrorMessage::WrapMessage("LP5890 - Register read failed");
+		return false;
+	}
+
+	// Registers are returned most significant word first, the same order they are written in
+	for (size_t chip = 0; chip < chainLength; chip++)
+	{
+		size_t slot  = 3 * GetChainSlot(chip);
+		values[chip] = { reply[slot + 2], reply[slot + 1], reply[slot] };
+	}
+
 	return true;
 }
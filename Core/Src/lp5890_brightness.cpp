@@ -0,0 +1,48 @@
+/**
+ * @file lp5890_brightness.cpp
+ * @author Aidan Orr
+ * @brief Brightness control of the LP5890 through its analog global and color group brightness
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "lp5890/brightness.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+using namespace LumiVoxel;
+using namespace LumiVoxel::Lp5890;
+
+void BrightnessControl::Set(float brightness)
+{
+	brightness = std::clamp(brightness, 0.0f, 1.0f);
+	if (brightness == requested)
+		return;
+
+	requested = brightness;
+
+	// The lowest global level that reaches the brightness leaves the most color group steps for the rest
+	int global = std::clamp(static_cast<int>(std::ceil(brightness * GlobalLevels)) - 1, 0, GlobalLevels - 1);
+	float scale = brightness * GlobalLevels / (global + 1);
+
+	// Below the analog range the color balance would become too coarse, the digital scale covers the remainder
+	float residual = 1.0f;
+	if (scale < MinGroupScale)
+	{
+		residual = scale / MinGroupScale;
+		scale    = MinGroupScale;
+	}
+
+	auto groupLevel = [scale](uint8_t full) {
+		return static_cast<uint16_t>(std::clamp(std::lround(scale * (full + 1)) - 1, 0l, 255l));
+	};
+
+	fc3.GlobalBrightness     = static_cast<uint16_t>(global);
+	fc3.RedColorBrightness   = groupLevel(balance[0]);
+	fc3.GreenColorBrightness = groupLevel(balance[1]);
+	fc3.BlueColorBrightness  = groupLevel(balance[2]);
+
+	digitalScale = residual;
+}
@@ -0,0 +1,139 @@
+/**
+ * @file lp5890_diagnostics.cpp
+ * @author Aidan Orr
+ * @brief Incremental LED open and short detection of the LP5890
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "lp5890/diagnostics.hpp"
+
+#include <algorithm>
+
+using namespace LumiVoxel;
+using namespace LumiVoxel::Lp5890;
+
+bool Diagnostics::Step()
+{
+	const Detection& current = Detections[detection];
+
+	std::array<std::array<uint16_t, 3>, Driver::MaxChainLength> values;
+	std::span<std::array<uint16_t, 3>> chain = std::span(values).first(driver.GetChainLength());
+
+	bool success = false;
+	switch (stage)
+	{
+	case Stage::RequestLines:
+		success = driver.TryRequestRegister(current.LineRead);
+		stage   = Stage::FetchLines;
+		break;
+
+	case Stage::FetchLines:
+		success = driver.TryFetchRegister(chain);
+		if (success)
+		{
+			size_t lineCount = std::min<size_t>(driver.GetScanLineCount(), Driver::LedCount / Driver::LineLength);
+			uint32_t lines   = lineCount < 32 ? (1u << lineCount) - 1 : UINT32_MAX;
+
+			// The channel warnings of a line are read for every chip, so it is selected if any chip flags it
+			lineMask = 0;
+			for (size_t chip = 0; chip < chain.size(); chip++)
+			{
+				uint32_t chipMask = (chain[chip][0] | (static_cast<uint32_t>(chain[chip][1]) << 16)) & lines;
+				lineMask |= chipMask;
+
+				// Lines without warnings are clear of this kind of fault
+				for (size_t i = 0; i < lineCount; i++)
+				{
+					if ((chipMask & (1u << i)) == 0)
+						UpdateLine(chip, i, 0);
+				}
+			}
+
+			line = 0;
+			NextLine();
+		}
+		break;
+
+	case Stage::SelectLine:
+		success = driver.TryWriteRegister(current.LineSelect, { line, 0, 0 });
+		stage   = Stage::RequestChannels;
+		break;
+
+	case Stage::RequestChannels:
+		success = driver.TryRequestRegister(current.ChannelRead);
+		stage   = Stage::FetchChannels;
+		break;
+
+	case Stage::FetchChannels:
+		success = driver.TryFetchRegister(chain);
+		if (success)
+		{
+			for (size_t chip = 0; chip < chain.size(); chip++)
+			{
+				const std::array<uint16_t, 3>& value = chain[chip];
+				uint64_t channels                    = value[0] | (static_cast<uint64_t>(value[1]) << 16) | (static_cast<uint64_t>(value[2]) << 32);
+				UpdateLine(chip, line, channels);
+			}
+
+			line++;
+			NextLine();
+		}
+		break;
+	}
+
+	if (!success)
+	{
+		errorCount++;
+		stage = Stage::RequestLines;
+	}
+
+	return success;
+}
+
+void Diagnostics::UpdateLine(size_t chip, size_t scanLine, uint64_t channels)
+{
+	uint8_t shift = Detections[detection].Shift;
+	uint8_t mask  = static_cast<uint8_t>(0b111 << shift);
+
+	for (size_t channel = 0; channel < Driver::LineLength; channel++)
+	{
+		size_t index = chip * Driver::LedCount + scanLine * Driver::LineLength + channel;
+		if (index >= faults.size())
+			return;
+
+		// Channel warnings are ordered red, green then blue, one bit per channel of each color
+		uint8_t colors = static_cast<uint8_t>(((channels >> channel) & 1) |
+		                                      (((channels >> (Driver::LineLength + channel)) & 1) << 1) |
+		                                      (((channels >> (2 * Driver::LineLength + channel)) & 1) << 2));
+
+		uint8_t updated = static_cast<uint8_t>((faults[index] & ~mask) | (colors << shift));
+		if (updated == faults[index])
+			continue;
+
+		faults[index] = updated;
+
+		if (onFaultChange)
+			onFaultChange(index, updated);
+	}
+}
+
+void Diagnostics::NextLine()
+{
+	while (line < 32 && (lineMask & (1u << line)) == 0)
+		line++;
+
+	if (line < 32)
+	{
+		stage = Stage::SelectLine;
+		return;
+	}
+
+	// Both kinds of fault are detected in turn, a sweep ends after shorts
+	detection = (detection + 1) % Detections.size();
+	if (detection == 0)
+		sweepCount++;
+
+	stage = Stage::RequestLines;
+}
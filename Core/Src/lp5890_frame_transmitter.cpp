@@ -0,0 +1,96 @@
+/**
+ * @file lp5890_frame_transmitter.cpp
+ * @author Aidan Orr
+ * @brief Writes a frame to LED drivers on separate interfaces at the same time
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "lp5890/frame_transmitter.hpp"
+
+#include "critical_section.h"
+
+using namespace LumiVoxel;
+using namespace LumiVoxel::Lp5890;
+
+bool FrameTransmitter::TransmitColors()
+{
+	for (Driver& driver : drivers)
+	{
+		if (driver.IsModified())
+			driver.TryBeginWriteColors();
+	}
+
+	bool writing = true;
+	while (writing)
+	{
+		writing = false;
+
+		// Each pass only starts the next write of the links that are idle, none of them waits on another
+		for (Driver& driver : drivers)
+		{
+			if (!driver.IsWritingColors())
+				continue;
+
+			// A failed write stays modified and is retried on the next frame, it is not latched meanwhile
+			if (!driver.TryServiceWriteColors())
+				continue;
+
+			writing |= driver.IsWritingColors();
+		}
+	}
+
+	// The status polls block on the bus of their interface, so they wait until every link finished writing
+	for (Driver& driver : drivers)
+	{
+		if (driver.IsStatusPollPending())
+			driver.TryPollStatus();
+	}
+
+	bool latchPending = false;
+	for (Driver& driver : drivers)
+		latchPending |= driver.IsLatchPending();
+
+	return latchPending;
+}
+
+bool FrameTransmitter::TrySendVsync()
+{
+	bool sent = true;
+
+	// Only drivers whose write completed are latched, and a driver that cannot be prepared is left out, the others
+	// still latch
+	for (Driver& driver : drivers)
+	{
+		if (driver.IsLatchPending())
+			sent &= driver.TryPrepareVsync();
+	}
+
+	uint32_t primask = EnterCriticalSection();
+
+	for (Driver& driver : drivers)
+	{
+		if (driver.IsTransferActive())
+			sent &= driver.TryStartVsync();
+	}
+
+	ExitCriticalSection(primask);
+
+	bool active = true;
+	while (active)
+	{
+		active = false;
+
+		for (Driver& driver : drivers)
+		{
+			if (!driver.IsTransferActive())
+				continue;
+
+			sent &= driver.TryServiceVsync();
+			active |= driver.IsTransferActive();
+		}
+	}
+
+	return sent;
+}
@@ -0,0 +1,148 @@
+/**
+ * @file lp5890_link_training.cpp
+ * @author Aidan Orr
+ * @brief Search for the highest CCSI data rate the LED driver links run without errors
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "lp5890/link_training.hpp"
+
+#include "binary_log.hpp"
+#include "errors.hpp"
+#include "flash_store.hpp"
+
+#include <array>
+#include <span>
+
+using namespace LumiVoxel;
+using namespace LumiVoxel::Lp5890;
+
+static constexpr std::array<Command, Driver::ConfigRegisterCount> ConfigReads = {
+	Command::FC0_READ, Command::FC1_READ, Command::FC2_READ, Command::FC3_READ, Command::FC4_READ
+};
+
+bool LinkTraining::TrySetRate(uint8_t rate)
+{
+	for (Driver& driver : drivers)
+	{
+		if (!driver.TrySetCcsiDataRate(rate))
+			return false;
+	}
+
+	return true;
+}
+
+bool LinkTraining::TryRestoreRate(uint8_t rate)
+{
+	for (Driver& driver : drivers)
+	{
+		// The rate is set over SPI, so it drops even while the CCSI link is down, the configuration follows the recovery
+		driver.TrySetCcsiDataRate(rate);
+
+		if (!driver.TryRecoverLink() || !driver.TryWriteDirtyConfig())
+			return false;
+	}
+
+	return true;
+}
+
+bool LinkTraining::Validate(size_t frames)
+{
+	for (size_t frame = 0; frame < frames; frame++)
+	{
+		for (Driver& driver : drivers)
+		{
+			uint32_t errors = driver.GetLinkErrorCount();
+
+			if (!driver.TryWriteColors() || !driver.TrySendVsync())
+				return false;
+
+			std::array<std::array<uint16_t, 3>, Driver::MaxChainLength> values;
+			std::span<std::array<uint16_t, 3>> chain = std::span(values).first(driver.GetChainLength());
+
+			for (size_t i = 0; i < ConfigReads.size(); i++)
+			{
+				if (!driver.TryReadRegister(ConfigReads[i], chain))
+					return false;
+
+				for (size_t chip = 0; chip < chain.size(); chip++)
+				{
+					const std::array<uint16_t, 3>& value = chain[chip];
+					if (value != driver.GetWrittenConfig(i))
+					{
+						ErrorMessage::SetMessage("LP5890 - Link validation failed: FC%u of chip %u read back %04X%04X%04X", i, chip, value[2], value[1], value[0]);
+						return false;
+					}
+				}
+			}
+
+			if (driver.GetLinkErrorCount() != errors)
+			{
+				ErrorMessage::SetMessage("LP5890 - Link validation failed: %u link errors", driver.GetLinkErrorCount() - errors);
+				return false;
+			}
+		}
+	}
+
+	return true;
+}
+
+uint8_t LinkTraining::Train(size_t frames)
+{
+	uint8_t good = drivers.front().get().GetCcsiDataRate();
+
+	for (uint8_t rate = good + 1; rate < Lp5899::CcsiDataRates.size(); rate++)
+	{
+		if (!TrySetRate(rate) || !Validate(frames))
+		{
+			LOG_BINARY("CCSI link failed at %lu bps", Lp5899::CcsiDataRates[rate]);
+			break;
+		}
+
+		good = rate;
+	}
+
+	// The failed rate may have left the links in fail-safe, the last good rate is restored either way
+	if (!TryRestoreRate(good))
+		LOG_BINARY("CCSI link could not return to %lu bps", Lp5899::CcsiDataRates[good]);
+
+	return good;
+}
+
+bool LinkTraining::TryConfigure(size_t frames)
+{
+	Result stored;
+	if (FlashStore::TryLoad(StoreKey, stored) && stored.DataRate < Lp5899::CcsiDataRates.size())
+	{
+		if (TrySetRate(stored.DataRate) && Validate(frames))
+		{
+			LOG_BINARY("CCSI link running at stored %lu bps", Lp5899::CcsiDataRates[stored.DataRate]);
+			return true;
+		}
+
+		// The stored rate no longer holds, search again from the default
+		LOG_BINARY("CCSI link failed at stored %lu bps, retraining", Lp5899::CcsiDataRates[stored.DataRate]);
+		if (!TryRestoreRate(Driver::DefaultCcsiDataRate))
+		{
+			ErrorMessage::WrapMessage("LP5890 - Link training failed: Could not return to the default rate");
+			return false;
+		}
+	}
+
+	uint8_t rate = Train(frames);
+	if (!Validate(frames))
+	{
+		ErrorMessage::WrapMessage("LP5890 - Link training failed: No rate validated");
+		return false;
+	}
+
+	LOG_BINARY("CCSI link trained to %lu bps", Lp5899::CcsiDataRates[rate]);
+
+	Result result = { .DataRate = rate, .Reserved = { 0 } };
+	if (!FlashStore::TryStore(StoreKey, result))
+		LOG_BINARY("CCSI link training result could not be stored");
+
+	return true;
+}
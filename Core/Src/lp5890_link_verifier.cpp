@@ -0,0 +1,98 @@
+/**
+ * @file lp5890_link_verifier.cpp
+ * @author Aidan Orr
+ * @brief Read-back verification of the state written to the LP5890 over CCSI
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "lp5890/link_verifier.hpp"
+
+#include "binary_log.hpp"
+
+#include <algorithm>
+#include <span>
+
+using namespace LumiVoxel;
+using namespace LumiVoxel::Lp5890;
+
+bool LinkVerifier::IsProbeDue()
+{
+	uint64_t now     = counter.GetCount();
+	uint64_t elapsed = now - lastUpdate;
+	lastUpdate       = now;
+
+	if (overhead <= 0 || !driver.IsLinkHealthy())
+		return false;
+
+	// The data rate is in bits per second and the counter in microseconds
+	float bitsPerMicrosecond = Lp5899::CcsiDataRates[driver.GetCcsiDataRate()] / 1e6f;
+	float probeBits          = GetProbeBits();
+
+	// A link that was idle does not save up for a burst of probes
+	credit = std::min(credit + elapsed * bitsPerMicrosecond * overhead, MaxCreditProbes * probeBits);
+
+	return credit >= probeBits;
+}
+
+bool LinkVerifier::Step()
+{
+	bool success = awaitingReply ? TryCompare() : TryRequest();
+	if (!success)
+		errorCount++;
+
+	return success;
+}
+
+bool LinkVerifier::TryRequest()
+{
+	// A register waiting to be written does not hold its written value, it is skipped until it was written
+	uint8_t dirty = driver.GetDirtyConfig();
+	for (size_t i = 0; i < ConfigReads.size() && (dirty & (1 << nextRegister)); i++)
+		nextRegister = (nextRegister + 1) % ConfigReads.size();
+
+	if (dirty & (1 << nextRegister))
+		return true;
+
+	credit -= GetProbeBits();
+
+	probeRegister = nextRegister;
+	expected      = driver.GetWrittenConfig(probeRegister);
+	nextRegister  = (nextRegister + 1) % ConfigReads.size();
+
+	if (!driver.TryRequestRegister(ConfigReads[probeRegister]))
+		return false;
+
+	awaitingReply = true;
+	return true;
+}
+
+bool LinkVerifier::TryCompare()
+{
+	awaitingReply = false;
+
+	std::array<std::array<uint16_t, 3>, Driver::MaxChainLength> values;
+	std::span<std::array<uint16_t, 3>> chain = std::span(values).first(driver.GetChainLength());
+
+	if (!driver.TryFetchRegister(chain))
+		return false;
+
+	probeCount++;
+
+	for (size_t chip = 0; chip < chain.size(); chip++)
+	{
+		const std::array<uint16_t, 3>& value = chain[chip];
+		if (value == expected)
+			continue;
+
+		LOG_BINARY("LP5890 - FC%u of chip %u read back %04X%04X%04X, sending the frame again", probeRegister, chip, value[2], value[1], value[0]);
+
+		// The chips share every register value, so writing it again repairs all of them
+		mismatchCount++;
+		driver.Retransmit(1 << probeRegister);
+		break;
+	}
+
+	return true;
+}
@@ -9,15 +9,22 @@
 
 #include "lp5899.hpp"
 
+#include "binary_log.hpp"
 #include "critical_section.h"
 #include "errors.hpp"
 #include "high_precision_counter.hpp"
+#include "memory_regions.h"
 
+#include <algorithm>
+#include <array>
 #include <cstdio>
+#include <cstring>
 #include <span>
 
 using namespace LumiVoxel;
 
+DmaPool<Lp5899::TransferBuffers, Lp5899::MaxInterfaces> Lp5899::transferPool DMA_BUFFER_D2;
+
 static void WaitCycles(size_t cycles)
 {
 	for (size_t i = 0; i < cycles; ++i)
@@ -26,18 +33,30 @@ static void WaitCycles(size_t cycles)
 
 static void CrcFailErrorMessage(const char* startMsg, std::span<uint16_t> data, uint16_t crc, uint16_t crc1)
 {
-	constexpr size_t msgSize        = 512;
-	std::shared_ptr<char[]> message = std::shared_ptr<char[]>(new char[msgSize]);
-
-	char dataMsg[128];
-
-	size_t index = 0;
-	for (size_t i = 0; i < data.size(); ++i)
-		index += snprintf(dataMsg + index, sizeof(dataMsg) - index, "%04X ", data[i]);
-
-	snprintf(message.get(), msgSize, "%s: CRC mismatch: %04X != %04X, Data: %s", startMsg, crc, crc1, dataMsg);
-
-	ErrorMessage::SetMessage(message);
+	std::array<uint16_t, 4> words = { 0 };
+	std::copy_n(data.begin(), std::min(data.size(), words.size()), words.begin());
+
+	// Only the first few words are kept, the format is picked by how many there are
+	switch (std::clamp<size_t>(data.size(), 1, words.size() + 1))
+	{
+	case 1:
+		ErrorMessage::SetMessage("CRC mismatch: %04X != %04X, Data: %04X", crc, crc1, words[0]);
+		break;
+	case 2:
+		ErrorMessage::SetMessage("CRC mismatch: %04X != %04X, Data: %04X %04X", crc, crc1, words[0], words[1]);
+		break;
+	case 3:
+		ErrorMessage::SetMessage("CRC mismatch: %04X != %04X, Data: %04X %04X %04X", crc, crc1, words[0], words[1], words[2]);
+		break;
+	case 4:
+		ErrorMessage::SetMessage("CRC mismatch: %04X != %04X, Data: %04X %04X %04X %04X", crc, crc1, words[0], words[1], words[2], words[3]);
+		break;
+	default:
+		ErrorMessage::SetMessage("CRC mismatch: %04X != %04X, Data: %04X %04X %04X %04X ...", crc, crc1, words[0], words[1], words[2], words[3]);
+		break;
+	}
+
+	ErrorMessage::WrapMessage(startMsg);
 }
 
 static void FlushSPI(SPI_HandleTypeDef* spi, size_t extraReads = 4)
@@ -62,13 +81,29 @@ bool Lp5899::Init(HighPrecisionCounter& hpc)
 
 	ErrorMessage::ClearMessage();
 
+	// Kept across failed attempts, an interface only ever takes one
+	if (transfer == nullptr)
+		transfer = transferPool.Allocate();
+
+	if (transfer == nullptr)
+	{
+		ErrorMessage::SetMessage("LP5899 - Initialization failed: More than %u interfaces", static_cast<unsigned int>(MaxInterfaces));
+		return false;
+	}
+
+	if (!MemoryRegionsIsDmaReachable(transfer, sizeof(TransferBuffers)))
+	{
+		ErrorMessage::SetMessage("LP5899 - Initialization failed: Transfer buffers are not DMA reachable");
+		return false;
+	}
+
 	HAL_Delay(10);
 
 	// Initialize the SPI interface
 	HAL_StatusTypeDef status = HAL_SPI_Init(spi);
 	if (status != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Initialization failed: HAL SPI init failed");
+		ErrorMessage::SetError(status, "LP5899 - Initialization failed: HAL SPI init failed");
 		return false;
 	}
 
@@ -149,6 +184,8 @@ bool Lp5899::Init(HighPrecisionCounter& hpc)
 
 	ErrorMessage::ClearMessage();
 
+	counter     = &hpc;
+	linkState   = LinkState::Healthy;
 	initialized = true;
 	return true;
 }
@@ -161,6 +198,12 @@ bool Lp5899::TryReadRegister(Lp5899::RegisterAddr reg, uint16_t& value, bool che
 		return false;
 	}
 
+	if (transferState != TransferState::Idle)
+	{
+		ErrorMessage::SetMessage("LP5899 - Read Register failed: Transfer in progress");
+		return false;
+	}
+
 	uint32_t primask = EnterCriticalSection();
 
 	// FlushSPI(spi);
@@ -183,7 +226,7 @@ bool Lp5899::TryReadRegister(Lp5899::RegisterAddr reg, uint16_t& value, bool che
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Read Register failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Read Register failed: HAL SPI transmit/receive failed");
 		ExitCriticalSection(primask);
 		return false;
 	}
@@ -195,6 +238,7 @@ bool Lp5899::TryReadRegister(Lp5899::RegisterAddr reg, uint16_t& value, bool che
 
 		if (calculatedCrc1 != crc1)
 		{
+			crcErrorCount++;
 			CrcFailErrorMessage("LP5899 - Read Register failed", recvData, calculatedCrc1, crc1);
 			ExitCriticalSection(primask);
 			return false;
@@ -214,6 +258,12 @@ bool Lp5899::TryWriteRegister(Lp5899::RegisterAddr reg, uint16_t value, bool che
 		return false;
 	}
 
+	if (transferState != TransferState::Idle)
+	{
+		ErrorMessage::SetMessage("LP5899 - Write Register failed: Transfer in progress");
+		return false;
+	}
+
 	uint32_t primask = EnterCriticalSection();
 
 	uint16_t addr    = static_cast<uint16_t>(reg) << 6;
@@ -234,7 +284,7 @@ bool Lp5899::TryWriteRegister(Lp5899::RegisterAddr reg, uint16_t value, bool che
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Write Register failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Write Register failed: HAL SPI transmit/receive failed");
 		ExitCriticalSection(primask);
 		return false;
 	}
@@ -246,6 +296,7 @@ bool Lp5899::TryWriteRegister(Lp5899::RegisterAddr reg, uint16_t value, bool che
 
 		if (calculatedCrc1 != crc1)
 		{
+			crcErrorCount++;
 			CrcFailErrorMessage("LP5899 - Write Register failed", recvData, calculatedCrc1, crc1);
 			ExitCriticalSection(primask);
 			return false;
@@ -278,7 +329,7 @@ bool Lp5899::TryReadRegisterInit(Lp5899::RegisterAddr reg, uint16_t& value, bool
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Read Register failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Read Register failed: HAL SPI transmit/receive failed");
 		ExitCriticalSection(primask);
 		return false;
 	}
@@ -290,6 +341,7 @@ bool Lp5899::TryReadRegisterInit(Lp5899::RegisterAddr reg, uint16_t& value, bool
 
 		if (calculatedCrc1 != crc1)
 		{
+			crcErrorCount++;
 			CrcFailErrorMessage("LP5899 - Read Register failed", recvData, calculatedCrc1, crc1);
 			ExitCriticalSection(primask);
 			return false;
@@ -323,7 +375,7 @@ bool Lp5899::TryWriteRegisterInit(Lp5899::RegisterAddr reg, uint16_t value, bool
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Write Register failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Write Register failed: HAL SPI transmit/receive failed");
 		ExitCriticalSection(primask);
 		return false;
 	}
@@ -335,6 +387,7 @@ bool Lp5899::TryWriteRegisterInit(Lp5899::RegisterAddr reg, uint16_t value, bool
 
 		if (calculatedCrc1 != crc1)
 		{
+			crcErrorCount++;
 			CrcFailErrorMessage("LP5899 - Write Register failed", recvData, calculatedCrc1, crc1);
 			ExitCriticalSection(primask);
 			return false;
@@ -352,6 +405,8 @@ bool Lp5899::TrySoftReset()
 {
 	puts("Soft Resetting LP5899...");
 
+	txFifoLevel = UnknownTxFifoLevel;
+
 	uint32_t primask = EnterCriticalSection();
 
 	std::array<uint16_t, 2> sendData = { 0xE1E1, 0xD383 };
@@ -368,7 +423,7 @@ bool Lp5899::TrySoftReset()
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Soft Reset failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Soft Reset failed: HAL SPI transmit/receive failed");
 		ExitCriticalSection(primask);
 		return false;
 	}
@@ -380,6 +435,7 @@ bool Lp5899::TrySoftReset()
 	uint16_t crc1 = recvData[1];
 	if (crc != crc1)
 	{
+		crcErrorCount++;
 		CrcFailErrorMessage("LP5899 - Soft Reset failed", recvData, crc, crc1);
 		ExitCriticalSection(primask);
 		return false;
@@ -436,6 +492,18 @@ bool Lp5899::TryForwardWriteData(std::span<uint16_t> data, bool bufferData, bool
 		return false;
 	}
 
+	if (transferState != TransferState::Idle)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Transfer in progress");
+		return false;
+	}
+
+	if (linkState != LinkState::Healthy)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Link not healthy, state %u", linkState);
+		return false;
+	}
+
 	uint16_t wordCount = static_cast<uint16_t>(data.size());
 	if (wordCount >= maxDataSize)
 	{
@@ -446,7 +514,7 @@ bool Lp5899::TryForwardWriteData(std::span<uint16_t> data, bool bufferData, bool
 	if (!checkCrc)
 	{
 		uint16_t fifoSize = bufferData ? wordCount - 1 : 0;
-		if (!TryWriteTxFifoControl({ .TxFifoLevel = fifoSize, .TxFifoClear = 0 }, true))
+		if (fifoSize != txFifoLevel && !TryWriteTxFifoControl({ .TxFifoLevel = fifoSize, .TxFifoClear = 0 }, true))
 		{
 			ErrorMessage::WrapMessage("LP5899 - Forward Data failed: Failed to write TX FIFO control register");
 			return false;
@@ -472,10 +540,15 @@ bool Lp5899::TryForwardWriteData(std::span<uint16_t> data, bool bufferData, bool
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Forward Data failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Forward Data failed: HAL SPI transmit/receive failed");
 		return false;
 	}
 
+	return TryCheckForwardReply(recvData, checkCrc);
+}
+
+bool Lp5899::TryCheckForwardReply(std::span<uint16_t> recvData, bool checkCrc)
+{
 	if (checkCrc)
 	{
 		uint16_t calculatedCrc1 = CalculateCrc(std::span((uint8_t*)&recvData[0], 1 * sizeof(uint16_t)));
@@ -483,6 +556,8 @@ bool Lp5899::TryForwardWriteData(std::span<uint16_t> data, bool bufferData, bool
 
 		if (calculatedCrc1 != crc1)
 		{
+			crcErrorCount++;
+			ReportLinkError();
 			CrcFailErrorMessage("LP5899 - Forward Data failed", recvData, calculatedCrc1, crc1);
 			return false;
 		}
@@ -494,29 +569,151 @@ bool Lp5899::TryForwardWriteData(std::span<uint16_t> data, bool bufferData, bool
 
 	if (statusRegister.CcsiErrorFlag != 0)
 	{
-		InterfaceStatus interfaceStatus;
-		interfaceStatus.Value = 0;
-		if (TryReadInterfaceStatus(interfaceStatus, true))
+		ccsiErrorCount++;
+		ReportLinkError();
+
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: CCSI error, status %04X", statusRegister.Value);
+		return false;
+	}
+
+	return true;
+}
+
+bool Lp5899::TryPrepareForwardWrite(std::span<const uint16_t> data, bool bufferData, bool checkCrc)
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Not initialized");
+		return false;
+	}
+
+	if (transferState != TransferState::Idle)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Transfer in progress");
+		return false;
+	}
+
+	if (linkState != LinkState::Healthy)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Link not healthy, state %u", linkState);
+		return false;
+	}
+
+	uint16_t wordCount = static_cast<uint16_t>(data.size());
+	if (wordCount > MaxTransferWords)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Too many words to forward");
+		return false;
+	}
+
+	// The FIFO level is the only blocking access, it is skipped while the level stays the same
+	if (!checkCrc)
+	{
+		uint16_t fifoSize = bufferData ? wordCount - 1 : 0;
+		if (fifoSize != txFifoLevel && !TryWriteTxFifoControl({ .TxFifoLevel = fifoSize, .TxFifoClear = 0 }, true))
 		{
-			printf("LP5899 - Forward Data - Interface Status: %04X\n", interfaceStatus.Value);
+			ErrorMessage::WrapMessage("LP5899 - Forward Data failed: Failed to write TX FIFO control register");
 			return false;
 		}
-		else
-			TryWriteDeviceControl({ .ExitFailSafe = 1 }, true);
+	}
+
+	uint16_t command = static_cast<uint16_t>(checkCrc ? CommandType::FWD_WR_CRC : CommandType::FWD_WR) | ((wordCount - 1) & ((1 << 9) - 1));
+
+	std::array<uint16_t, 2 + MaxTransferWords>& send = transfer->Send;
+
+	send[0] = command;
+	std::copy(data.begin(), data.end(), send.begin() + 1);
+	send[1 + data.size()] = CalculateCrc(std::span((uint8_t*)send.data(), sizeof(uint16_t) * (1 + data.size())));
 
-		TryClearGlobalStatus(true);
+	transferWords    = wordCount + 2;
+	transferCheckCrc = checkCrc;
+	transferState    = TransferState::Prepared;
+	return true;
+}
+
+bool Lp5899::TryStartForwardWrite()
+{
+	if (transferState != TransferState::Prepared)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: No transfer prepared");
+		return false;
+	}
+
+	csPin.Reset();
 
-		ErrorMessage::WrapMessage("LP5899 - Forward Data failed: Failed to read interface status register");
+	HAL_StatusTypeDef status = HAL_SPI_Transmit_IT(spi, reinterpret_cast<uint8_t*>(transfer->Send.data()), transferWords);
+	if (status != HAL_OK)
+	{
+		csPin.Set();
+		transferState = TransferState::Idle;
+		ErrorMessage::SetError(status, "LP5899 - Forward Data failed: HAL SPI transmit failed");
 		return false;
 	}
 
+	transferState = TransferState::Transmitting;
 	return true;
 }
 
+bool Lp5899::TryServiceForwardWrite()
+{
+	if (transferState != TransferState::Transmitting && transferState != TransferState::Receiving)
+		return true;
+
+	if (HAL_SPI_GetState(spi) != HAL_SPI_STATE_READY)
+		return true;
+
+	// The transfer was completed by the SPI interrupt, its data must not be read from before the state changed
+	__DMB();
+
+	uint32_t error = HAL_SPI_GetError(spi);
+	if (error != HAL_SPI_ERROR_NONE)
+	{
+		csPin.Set();
+		transferState = TransferState::Idle;
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: HAL SPI error %08X", error);
+		return false;
+	}
+
+	if (transferState == TransferState::Transmitting)
+	{
+		transfer->Recv = { 0x0000, 0x0000 };
+
+		HAL_StatusTypeDef status = HAL_SPI_Receive_IT(spi, reinterpret_cast<uint8_t*>(transfer->Recv.data()), transfer->Recv.size());
+		if (status != HAL_OK)
+		{
+			csPin.Set();
+			transferState = TransferState::Idle;
+			ErrorMessage::SetError(status, "LP5899 - Forward Data failed: HAL SPI receive failed");
+			return false;
+		}
+
+		transferState = TransferState::Receiving;
+		return true;
+	}
+
+	csPin.Set();
+	transferState = TransferState::Idle;
+
+	return TryCheckForwardReply(transfer->Recv, transferCheckCrc);
+}
+
 bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t> rxData, size_t extraEndBytes, bool bufferData, bool checkCrc)
+{
+	if (!TryForwardReadRequest(txData, extraEndBytes, bufferData, checkCrc))
+		return false;
+
+	if (rxData.size() == 0)
+		return true;
+
+	// Give the driver chain time to return the data to the RX FIFO
+	HAL_Delay(10);
+
+	return TryReadData(rxData, checkCrc);
+}
+
+bool Lp5899::TryForwardReadRequest(std::span<uint16_t> txData, size_t extraEndBytes, bool bufferData, bool checkCrc)
 {
 	constexpr size_t maxDataSize      = 32;
-	constexpr size_t maxRxDataSize    = 32;
 	constexpr size_t maxExtraEndBytes = 1 << 7;
 
 	if (!initialized)
@@ -525,18 +722,23 @@ bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t>
 		return false;
 	}
 
-	uint16_t wordCount   = static_cast<uint16_t>(txData.size());
-	uint16_t rxWordCount = static_cast<uint16_t>(rxData.size());
+	if (transferState != TransferState::Idle)
+	{
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Transfer in progress");
+		return false;
+	}
 
-	if (wordCount > maxDataSize)
+	if (linkState != LinkState::Healthy)
 	{
-		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Too many words to forward");
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Link not healthy, state %u", linkState);
 		return false;
 	}
 
-	if (rxWordCount > maxRxDataSize)
+	uint16_t wordCount = static_cast<uint16_t>(txData.size());
+
+	if (wordCount > maxDataSize)
 	{
-		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Too many words to receive");
+		ErrorMessage::SetMessage("LP5899 - Forward Data failed: Too many words to forward");
 		return false;
 	}
 
@@ -549,7 +751,7 @@ bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t>
 	if (!checkCrc)
 	{
 		uint16_t fifoSize = bufferData ? wordCount - 1 : 0;
-		if (!TryWriteTxFifoControl({ .TxFifoLevel = fifoSize, .TxFifoClear = 0 }, true))
+		if (fifoSize != txFifoLevel && !TryWriteTxFifoControl({ .TxFifoLevel = fifoSize, .TxFifoClear = 0 }, true))
 		{
 			ErrorMessage::WrapMessage("LP5899 - Forward Data failed: Failed to write TX FIFO control register");
 			return false;
@@ -582,52 +784,48 @@ bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t>
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Forward Data failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Forward Data failed: HAL SPI transmit/receive failed");
 		return false;
 	}
 
-	if (checkCrc)
-	{
-		uint16_t calculatedCrc1 = CalculateCrc(std::span((uint8_t*)&statusReceiveData[0], 1 * sizeof(uint16_t)));
-		uint16_t crc1           = statusReceiveData[1];
-
-		if (calculatedCrc1 != crc1)
-		{
-			CrcFailErrorMessage("LP5899 - Forward Data failed", statusReceiveData, calculatedCrc1, crc1);
-			return false;
-		}
-	}
+	return TryCheckForwardReply(statusReceiveData, checkCrc);
+}
 
-	GlobalStatus statusRegister;
-	statusRegister.Value = statusReceiveData[0];
+bool Lp5899::TryReadData(std::span<uint16_t> rxData, bool checkCrc)
+{
+	constexpr size_t maxRxDataSize = 96; // A 48 bit register from each of 32 chained devices
 
-	if (statusRegister.CcsiErrorFlag != 0)
+	if (!initialized)
 	{
-		InterfaceStatus interfaceStatus;
-		interfaceStatus.Value = 0;
-		if (TryReadInterfaceStatus(interfaceStatus, true))
-		{
-			printf("LP5899 - Forward Data - Interface Status: %04X\n", interfaceStatus.Value);
-			return false;
-		}
-		else
-			TryWriteDeviceControl({ .ExitFailSafe = 1 }, true);
+		ErrorMessage::SetMessage("LP5899 - Data Read failed: Not initialized");
+		return false;
+	}
 
-		TryClearGlobalStatus(true);
+	if (transferState != TransferState::Idle)
+	{
+		ErrorMessage::SetMessage("LP5899 - Data Read failed: Transfer in progress");
+		return false;
+	}
 
-		ErrorMessage::WrapMessage("LP5899 - Forward Data failed: Failed to read interface status register");
+	if (linkState != LinkState::Healthy)
+	{
+		ErrorMessage::SetMessage("LP5899 - Data Read failed: Link not healthy, state %u", linkState);
 		return false;
 	}
 
-	if (rxData.size() == 0)
-		return true;
+	uint16_t rxWordCount = static_cast<uint16_t>(rxData.size());
 
-	HAL_Delay(10);
+	if (rxWordCount > maxRxDataSize)
+	{
+		ErrorMessage::SetMessage("LP5899 - Data Read failed: Too many words to receive");
+		return false;
+	}
 
-	// Read the RX FIFO data
-	std::array<uint16_t, 1 + maxRxDataSize> recvData = { 0 };
+	// Status word, data and CRC
+	std::array<uint16_t, 2 + maxRxDataSize> recvData = { 0 };
+	std::array<uint16_t, 2> sendData;
 
-	command = static_cast<uint16_t>(checkCrc ? CommandType::DATA_RD_CRC : CommandType::DATA_RD);
+	uint16_t command = static_cast<uint16_t>(checkCrc ? CommandType::DATA_RD_CRC : CommandType::DATA_RD);
 	command |= (rxWordCount & ((1 << 8) - 1));
 
 	sendData[0] = command;
@@ -635,14 +833,14 @@ bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t>
 
 	csPin.Reset();
 
-	status1 = HAL_SPI_Transmit(spi, reinterpret_cast<uint8_t*>(sendData.data()), 2, 100);
-	status2 = HAL_SPI_Receive(spi, reinterpret_cast<uint8_t*>(recvData.data()), rxWordCount + 2, 100);
+	HAL_StatusTypeDef status1 = HAL_SPI_Transmit(spi, reinterpret_cast<uint8_t*>(sendData.data()), 2, 100);
+	HAL_StatusTypeDef status2 = HAL_SPI_Receive(spi, reinterpret_cast<uint8_t*>(recvData.data()), rxWordCount + 2, 100);
 
 	csPin.Set();
 
 	if (status1 != HAL_OK || status2 != HAL_OK)
 	{
-		ErrorMessage::SetMessage("LP5899 - Forward Data failed: HAL SPI transmit/receive failed");
+		ErrorMessage::SetError(status1 != HAL_OK ? status1 : status2, "LP5899 - Data Read failed: HAL SPI transmit/receive failed");
 		return false;
 	}
 
@@ -653,6 +851,8 @@ bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t>
 
 		if (calculatedCrc1 != crc1)
 		{
+			crcErrorCount++;
+			ReportLinkError();
 			CrcFailErrorMessage("LP5899 - Data Read failed", recvData, calculatedCrc1, crc1);
 			return false;
 		}
@@ -662,3 +862,79 @@ bool Lp5899::TryForwardReadData(std::span<uint16_t> txData, std::span<uint16_t>
 
 	return true;
 }
+
+void Lp5899::ReportLinkError()
+{
+	if (linkState != LinkState::Healthy)
+		return;
+
+	// Recovery is left to `ServiceLink`, so the rest of the frame fails fast instead of retrying every transfer
+	linkState   = LinkState::Degraded;
+	txFifoLevel = UnknownTxFifoLevel;
+}
+
+void Lp5899::ServiceLink()
+{
+	if (!initialized || linkState == LinkState::Healthy)
+		return;
+
+	if (linkState != LinkState::Degraded && counter->GetCount() < retryTime)
+		return;
+
+	TryRecoverLink();
+}
+
+bool Lp5899::TryRecoverLink()
+{
+	if (!initialized)
+	{
+		ErrorMessage::SetMessage("LP5899 - Link recovery failed: Not initialized");
+		return false;
+	}
+
+	InterfaceStatus interfaceStatus;
+	interfaceStatus.Value = 0;
+	if (TryReadInterfaceStatus(interfaceStatus, true))
+		LOG_BINARY("LP5899 - Link recovery - Interface Status: %04X", interfaceStatus.Value);
+
+	txFifoLevel = UnknownTxFifoLevel;
+
+	GlobalStatus statusRegister;
+	statusRegister.Value = 0;
+
+	bool recovered = TryWriteDeviceControl({ .ExitFailSafe = 1 }, true) &&
+	                 TryClearGlobalStatus(true) &&
+	                 TryReadGlobalStatus(statusRegister, true) &&
+	                 statusRegister.GlobalErrorFlag == 0 &&
+	                 statusRegister.DeviceState == 0;
+
+	if (recovered)
+	{
+		if (linkState != LinkState::Healthy)
+		{
+			recoveryCount++;
+			resyncPending = true;
+			LOG_BINARY("LP5899 - Link recovered after %u failed attempts", failedRecoveries);
+		}
+
+		linkState        = LinkState::Healthy;
+		failedRecoveries = 0;
+		backoff          = 0;
+		return true;
+	}
+
+	if (failedRecoveries < UINT8_MAX)
+		failedRecoveries++;
+
+	bool failsafe = statusRegister.DeviceState == 0x3 || failedRecoveries >= FailsafeAttempts;
+	if (failsafe && linkState != LinkState::Failsafe)
+		LOG_BINARY("LP5899 - Link failsafe, status %04X", statusRegister.Value);
+
+	// A failsafe link is not expected back soon, so it is only retried at the longest backoff
+	backoff   = failsafe ? MaxBackoff : std::clamp<uint32_t>(backoff * 2, InitialBackoff, MaxBackoff);
+	retryTime = counter->GetCount() + backoff;
+	linkState = failsafe ? LinkState::Failsafe : LinkState::Recovering;
+
+	ErrorMessage::SetMessage("LP5899 - Link recovery failed: Status %04X, retry in %u us", statusRegister.Value, backoff);
+	return false;
+}
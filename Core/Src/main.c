@@ -22,6 +22,8 @@
 
 /* Private includes ----------------------------------------------------------*/
 /* USER CODE BEGIN Includes */
+#include "memory_regions.h"
+#include "syscall_retarget.hpp"
 
 /* USER CODE END Includes */
 
@@ -89,7 +91,7 @@ int main(void)
 {
 
   /* USER CODE BEGIN 1 */
-
+  MemoryRegionsConfigureMpu();
   /* USER CODE END 1 */
 
   /* Enable the CPU Cache */
@@ -694,6 +696,9 @@ void Error_Handler(void)
 
   /* User can add his own implementation to report the HAL error return state */
   __disable_irq();
+
+  /* Make sure the error message printed before getting here reaches the UART */
+  SyscallFlush();
   while (1)
   {
   }
@@ -11,13 +11,25 @@
 #include "app_bluenrg_2.h"
 #include "TriangleMesh.hpp"
 
+#include "binary_log.hpp"
 #include "errors.hpp"
+#include "frame_pacer.hpp"
 #include "high_precision_counter.hpp"
+#include "interrupt_queue.hpp"
 #include "lp5890.hpp"
+#include "lp5890/brightness.hpp"
+#include "lp5890/diagnostics.hpp"
+#include "lp5890/link_verifier.hpp"
+#include "lp5890/frame_transmitter.hpp"
+#include "lp5890/link_training.hpp"
 #include "lp5890/mappings.hpp"
 #include "lp5899.hpp"
+#include "memory_regions.h"
 #include "scheduler.hpp"
 #include "syscall_retarget.hpp"
+#include "telemetry.hpp"
+#include "voxel_compensation.hpp"
+#include "voxel_health.hpp"
 
 
 #include "stm32h7xx_hal.h"
@@ -27,9 +39,15 @@
 
 #include <cstdio>
 
+extern "C"
+{
+#include "hci_tl.h"
+}
+
 using namespace LumiVoxel;
 
 extern "C" UART_HandleTypeDef huart1;
+DMA_HandleTypeDef hdma_usart1_tx;
 extern "C" SPI_HandleTypeDef hspi1;
 extern "C" SPI_HandleTypeDef hspi2;
 extern "C" SPI_HandleTypeDef hspi3;
@@ -40,12 +58,16 @@ constexpr size_t zSize = 8;
 
 constexpr size_t numLeds = xSize * ySize * zSize;
 
-std::array<float, numLeds> red __attribute__((section(".dtcmram")));
-std::array<float, numLeds> green __attribute__((section(".dtcmram")));
-std::array<float, numLeds> blue __attribute__((section(".dtcmram")));
-float brightness = 1.0f;
+/// @brief LP5890s daisy chained behind each LP5899, each drives a module of 256 voxels
+constexpr size_t chainLength = numLeds / (2 * Lp5890::Driver::LedCount);
 
-TriangleMesh<256> triangleMesh __attribute__((section(".dtcmram")));
+std::array<float, numLeds> red DTCM_DATA;
+std::array<float, numLeds> green DTCM_DATA;
+std::array<float, numLeds> blue DTCM_DATA;
+float brightness        = 1.0f; ///< @brief Requested brightness, set over BLE
+float digitalBrightness = 1.0f; ///< @brief Grayscale scale for brightness below the analog range, set by `brightnessControl`
+
+TriangleMesh<256> triangleMesh DTCM_DATA;
 
 // std::array<float, 12> testVertices = {
 // 	0.51f, 0.0f, 0.0f,
@@ -63,10 +85,29 @@ TriangleMesh<256> triangleMesh __attribute__((section(".dtcmram")));
 
 Scheduler scheduler(TIM6, 500, 32, 500 * 60);
 HighPrecisionCounter hpCounter(TIM7, 10000);
-
-Lp5890::FC0 fc0 __attribute__((section(".dtcmram"))) = []() {
+Telemetry telemetry(hpCounter);
+FramePacer framePacer(hpCounter);
+
+/// @brief Target frame rate of the render loop in Hz, rounded to a whole number of LP5890 display periods
+constexpr float targetFrameRate = 50.0f;
+/// @brief Time in microseconds budgeted for latching and mapping a frame
+constexpr uint32_t renderBudget = 500;
+/// @brief Time in microseconds budgeted for writing a frame to both drivers
+constexpr uint32_t transmitBudget = 12000;
+/// @brief Time in microseconds left before the frame deadline needed to start a diagnostics register access
+constexpr uint32_t diagnosticsBudget = 300;
+/// @brief Time in microseconds left before the frame deadline needed to recover links and write changed configuration
+constexpr uint32_t driverServiceBudget = 2000;
+/// @brief Display period in microseconds the frame grid of `framePacer` was built on
+uint32_t pacedDisplayPeriod = 0;
+/// @brief Share of each LED driver link's bandwidth spent reading back what the chips hold, 0 disables verification
+constexpr float verificationOverhead = Lp5890::LinkVerifier::DefaultOverhead;
+/// @brief Frames each CCSI data rate is validated over during link training
+constexpr size_t linkTrainingFrames = 8;
+
+Lp5890::FC0 fc0 DTCM_DATA = []() {
 	Lp5890::FC0 fc0              = Lp5890::FC0::Default();
-	fc0.ChipNumber               = 0;
+	fc0.ChipNumber               = chainLength - 1;
 	fc0.PreDischargeEnable       = 1;
 	fc0.PowerSavingEnable        = 0;
 	fc0.PowerSavingPlusMode      = 0;
@@ -81,20 +122,20 @@ Lp5890::FC0 fc0 __attribute__((section(".dtcmram"))) = []() {
 	fc0.ModuleSize               = 0b01;
 	return fc0;
 }();
-Lp5890::FC1 fc1 __attribute__((section(".dtcmram"))) = []() {
+Lp5890::FC1 fc1 DTCM_DATA = []() {
 	Lp5890::FC1 fc1          = Lp5890::FC1::Default();
 	fc1.SegmentLength        = 1023;
 	fc1.BlackFieldAdjustment = 0;
 	return fc1;
 }();
-Lp5890::FC2 fc2 __attribute__((section(".dtcmram"))) = []() {
+Lp5890::FC2 fc2 DTCM_DATA = []() {
 	Lp5890::FC2 fc2              = Lp5890::FC2::Default();
 	fc2.RedPreDischargeVoltage   = 0b0110;
 	fc2.GreenPreDischargeVoltage = 0b0110;
 	fc2.BluePreDischargeVoltage  = 0b0110;
 	return fc2;
 }();
-Lp5890::FC3 fc3 __attribute__((section(".dtcmram"))) = []() {
+Lp5890::FC3 fc3 DTCM_DATA = []() {
 	Lp5890::FC3 fc3          = Lp5890::FC3::Default();
 	fc3.RedColorBrightness   = 255;
 	fc3.GreenColorBrightness = 160;
@@ -106,33 +147,329 @@ Lp5890::FC3 fc3 __attribute__((section(".dtcmram"))) = []() {
 	// fc3.BlueLedWeakThreshold  = 7;
 	return fc3;
 }();
-Lp5890::FC4 fc4 __attribute__((section(".dtcmram"))) = []() {
+Lp5890::FC4 fc4 DTCM_DATA = []() {
 	Lp5890::FC4 fc4 = Lp5890::FC4::Default();
 	fc4.MaxCurrent  = 1;
 	return fc4;
 }();
 
-Lp5899 if1 __attribute__((section(".dtcmram"))) (&hspi2, GpioPin(SPI2_NSS_GPIO_Port, SPI2_NSS_Pin));
-Lp5899 if2 __attribute__((section(".dtcmram"))) (&hspi3, GpioPin(SPI3_NSS_GPIO_Port, SPI3_NSS_Pin));
+Lp5890::BrightnessControl brightnessControl DTCM_DATA (fc3, digitalBrightness);
 
-Lp5890::Driver ledDriver1 __attribute__((section(".dtcmram"))) (if1, brightness, fc0, fc1, fc2, fc3, fc4);
-Lp5890::Driver ledDriver2 __attribute__((section(".dtcmram"))) (if2, brightness, fc0, fc1, fc2, fc3, fc4);
+Lp5899 if1 DTCM_DATA (&hspi2, GpioPin(SPI2_NSS_GPIO_Port, SPI2_NSS_Pin));
+Lp5899 if2 DTCM_DATA (&hspi3, GpioPin(SPI3_NSS_GPIO_Port, SPI3_NSS_Pin));
 
-std::array<Lp5890::DriverMapping, 512> ledMappings __attribute__((section(".dtcmram"))) = Lp5890::CreateDriverMappings(ledDriver2, ledDriver1);
+std::array<Lp5890::Color, chainLength * Lp5890::Driver::LedCount> driverColors1 DTCM_DATA;
+std::array<Lp5890::Color, chainLength * Lp5890::Driver::LedCount> driverColors2 DTCM_DATA;
 
-void UpdateDisplay()
+Lp5890::Driver ledDriver1 DTCM_DATA (if1, driverColors1, digitalBrightness, fc0, fc1, fc2, fc3, fc4);
+Lp5890::Driver ledDriver2 DTCM_DATA (if2, driverColors2, digitalBrightness, fc0, fc1, fc2, fc3, fc4);
+
+std::array<std::reference_wrapper<Lp5890::Driver>, 2> ledDrivers = { std::ref(ledDriver1), std::ref(ledDriver2) };
+Lp5890::LinkTraining linkTraining(ledDrivers);
+Lp5890::FrameTransmitter frameTransmitter(ledDrivers);
+
+std::array<Lp5890::DriverMapping, numLeds> ledMappings DTCM_DATA = Lp5890::CreateDriverMappings<xSize, ySize, zSize>(std::array{ std::ref(ledDriver2), std::ref(ledDriver1) });
+
+std::array<uint8_t, chainLength * Lp5890::Driver::LedCount> driverFaults1 DTCM_DATA;
+std::array<uint8_t, chainLength * Lp5890::Driver::LedCount> driverFaults2 DTCM_DATA;
+
+Lp5890::Diagnostics diagnostics1 DTCM_DATA (ledDriver1, driverFaults1);
+Lp5890::Diagnostics diagnostics2 DTCM_DATA (ledDriver2, driverFaults2);
+std::array<std::reference_wrapper<Lp5890::Diagnostics>, 2> diagnostics = { std::ref(diagnostics1), std::ref(diagnostics2) };
+
+Lp5890::LinkVerifier linkVerifier1 DTCM_DATA (ledDriver1, hpCounter, verificationOverhead);
+Lp5890::LinkVerifier linkVerifier2 DTCM_DATA (ledDriver2, hpCounter, verificationOverhead);
+std::array<std::reference_wrapper<Lp5890::LinkVerifier>, 2> linkVerifiers = { std::ref(linkVerifier1), std::ref(linkVerifier2) };
+
+/// @brief Read slots of one driver link, shared by its diagnostics and link verification
+struct ReadbackSlots
+{
+	bool verifierLast                 = false; ///< @brief Whether the last slot completed a link verification probe
+	uint32_t diagnosticsSteps         = 0;     ///< @brief Slots given to diagnostics
+	uint32_t verifierSteps            = 0;     ///< @brief Slots given to link verification
+	uint32_t reportedDiagnosticsSteps = 0;     ///< @brief `diagnosticsSteps` at the last report
+	uint32_t reportedVerifierSteps    = 0;     ///< @brief `verifierSteps` at the last report
+};
+
+std::array<ReadbackSlots, 2> readbackSlots DTCM_DATA;
+
+/// @brief Voxel lit by each LED of each driver in `diagnostics`, the inverse of `ledMappings`
+std::array<std::array<uint16_t, chainLength * Lp5890::Driver::LedCount>, 2> driverVoxels DTCM_DATA;
+VoxelHealth<numLeds> voxelHealth DTCM_DATA;
+VoxelCompensation<xSize, ySize, zSize> voxelCompensation DTCM_DATA;
+
+size_t nextDiagnostics = 0; ///< @brief Driver whose diagnostics run next
+size_t diagnosticsPage = 0; ///< @brief Page of the failed voxel list sent next
+
+void MapColors()
 {
+	// Failed LED channels are compensated by their neighbours without changing the rendered colors
+	voxelCompensation.Update(voxelHealth, red, green, blue);
+
 	for (size_t i = 0; i < numLeds; ++i)
 	{
+		float r = red[i];
+		float g = green[i];
+		float b = blue[i];
+		voxelCompensation.Adjust(i, r, g, b);
+
 		Lp5890::DriverMapping& mapping = ledMappings[i];
-		mapping.LedDriver.get().SetColor(mapping.Index, red[i], green[i], blue[i]);
+		mapping.LedDriver.get().SetColor(mapping.Index, r, g, b);
+	}
+}
+
+/**
+ * @brief Write the colors of the drivers whose colors changed, both halves of the cube at the same time
+ *
+ * @return `bool` Whether any driver was written and needs a VSYNC to display it
+ */
+bool TransmitColors()
+{
+	return frameTransmitter.TransmitColors();
+}
+
+/**
+ * @brief Latch the written colors of both halves of the cube together
+ */
+void SendVsync()
+{
+	frameTransmitter.TrySendVsync();
+}
+
+void UpdateDisplay()
+{
+	telemetry.BeginFrame();
+
+	MapColors();
+
+	telemetry.EndStage(Telemetry::Stage::Map);
+
+	TransmitColors();
+
+	telemetry.EndStage(Telemetry::Stage::WriteColors);
+
+	SendVsync();
+
+	telemetry.EndStage(Telemetry::Stage::Vsync);
+	telemetry.EndFrame();
+}
+
+/**
+ * @brief Recover unhealthy driver links outside of the transfer path, a recovered driver is sent its full state again
+ */
+void ServiceLinks()
+{
+	for (Lp5890::Driver& driver : ledDrivers)
+		driver.ServiceLink();
+}
+
+/**
+ * @brief Write the configuration registers changed since the last frame, before the VSYNC that starts the next frame
+ */
+void PushConfig()
+{
+	// Brightness changes land in FC3, the grayscale data only changes below the analog range
+	brightnessControl.Set(brightness);
+
+	uint8_t dirty = ledDriver1.GetDirtyConfig() | ledDriver2.GetDirtyConfig();
+	if (dirty == 0)
+		return;
+
+	if (!ledDriver1.TryWriteDirtyConfig() || !ledDriver2.TryWriteDirtyConfig())
+		LOG_BINARY("LED driver configuration write failed, dirty registers %02X", dirty);
+
+	// The frame grid is built on whole display periods, so it restarts when the scan timing changes. A recovered link
+	// writes FC0 and FC1 again with the same values, which keeps the grid and the VSYNC phase in place.
+	uint32_t displayPeriod = ledDriver1.GetDisplayPeriod();
+	if ((dirty & Lp5890::Driver::TimingConfig) && displayPeriod != pacedDisplayPeriod)
+	{
+		pacedDisplayPeriod = displayPeriod;
+		framePacer.Configure(targetFrameRate, displayPeriod, renderBudget, transmitBudget);
 	}
+}
 
-	ledDriver1.TryWriteColors();
-	ledDriver2.TryWriteColors();
+/**
+ * @brief Recover links and write the changed configuration if it fits before the frame deadline
+ * @remark Both block on the bus, so they run after the frame was latched and written and never move its VSYNC
+ */
+void ServiceDrivers()
+{
+	if (hpCounter.GetCount() + driverServiceBudget > framePacer.GetFrameDeadline())
+		return;
 
-	ledDriver1.TrySendVsync();
-	ledDriver2.TrySendVsync();
+	ServiceLinks();
+	PushConfig();
+}
+
+/**
+ * @brief Render one paced frame, the data written in the previous frame is latched on the frame boundary
+ *
+ * @param vsyncPending Whether data was written in the previous frame, updated to whether data was written in this frame
+ */
+void RenderFrame(bool& vsyncPending)
+{
+	framePacer.BeginFrame();
+	telemetry.BeginFrame();
+
+	if (vsyncPending)
+		SendVsync();
+
+	telemetry.EndStage(Telemetry::Stage::Vsync);
+
+	MapColors();
+
+	telemetry.EndStage(Telemetry::Stage::Map);
+	framePacer.EndPhase(FramePacer::Phase::Render);
+
+	vsyncPending = TransmitColors();
+
+	telemetry.EndStage(Telemetry::Stage::WriteColors);
+	telemetry.EndFrame();
+
+	if (vsyncPending)
+		framePacer.EndPhase(FramePacer::Phase::Transmit);
+	else
+		framePacer.SkipTransmit();
+}
+
+/**
+ * @brief Perform one diagnostics or link verification register access if it fits before the frame deadline, alternating
+ * between the drivers
+ */
+void RunDiagnostics()
+{
+	if (hpCounter.GetCount() + diagnosticsBudget > framePacer.GetFrameDeadline())
+		return;
+
+	Lp5890::Diagnostics& driverDiagnostics = diagnostics[nextDiagnostics];
+	Lp5890::LinkVerifier& linkVerifier     = linkVerifiers[nextDiagnostics];
+	ReadbackSlots& slots                   = readbackSlots[nextDiagnostics];
+
+	// Both read through the RX FIFO of the interface, so one only forwards a read once the other collected its reply.
+	// The slot after a completed probe always goes to diagnostics, so verification never takes more than half of them.
+	bool verify = linkVerifier.IsAwaitingReply() ||
+	              (!slots.verifierLast && !driverDiagnostics.IsAwaitingReply() && linkVerifier.IsProbeDue());
+
+	if (verify)
+	{
+		linkVerifier.Step();
+		slots.verifierSteps++;
+	}
+	else
+	{
+		driverDiagnostics.Step();
+		slots.diagnosticsSteps++;
+	}
+
+	slots.verifierLast = verify && !linkVerifier.IsAwaitingReply();
+
+	nextDiagnostics = (nextDiagnostics + 1) % diagnostics.size();
+}
+
+void SendDiagnostics()
+{
+	size_t pages = std::max<size_t>(voxelHealth.GetPageCount(), 1);
+	diagnosticsPage %= pages;
+
+	VoxelHealth<numLeds>::Packet packet = voxelHealth.Pack(diagnosticsPage++);
+	BLE_Notify(BLE_NOTIFY_DIAGNOSTICS, reinterpret_cast<uint8_t*>(&packet), sizeof(packet));
+}
+
+void InitializeDiagnostics()
+{
+	// Faults are found per driver LED, so the voxel mapping is inverted to attribute them to voxels
+	for (size_t voxel = 0; voxel < numLeds; voxel++)
+	{
+		const Lp5890::DriverMapping& mapping = ledMappings[voxel];
+		size_t driver                        = &mapping.LedDriver.get() == &ledDriver1 ? 0 : 1;
+
+		driverVoxels[driver][mapping.Index] = static_cast<uint16_t>(voxel);
+	}
+
+	for (size_t driver = 0; driver < diagnostics.size(); driver++)
+	{
+		diagnostics[driver].get().SetFaultCallback([driver](size_t index, uint8_t faults) {
+			uint16_t voxel = driverVoxels[driver][index];
+			voxelHealth.SetFaults(voxel, faults);
+
+			LOG_BINARY("Voxel %u faults changed to %02X, driver %u LED %u", voxel, faults, driver + 1, index);
+		});
+	}
+}
+
+void SendTelemetry()
+{
+	Telemetry::Packet packet = telemetry.Sample(
+		if1.GetCrcErrorCount() + if2.GetCrcErrorCount(),
+		if1.GetCcsiErrorCount() + if2.GetCcsiErrorCount(),
+		BLE_GetNotifyQueueDepth(),
+		framePacer.GetMissedDeadlines());
+
+	BLE_Notify(BLE_NOTIFY_TELEMETRY, reinterpret_cast<uint8_t*>(&packet), sizeof(packet));
+}
+
+void ReportCycleProfile()
+{
+	std::array<uint32_t, Telemetry::StageCount> cycles = telemetry.SampleCycles();
+
+	uint32_t total = 0;
+	for (uint32_t stage : cycles)
+		total += stage;
+
+	LOG_BINARY("Cycles per frame with hot code in %s: map %lu, write %lu, vsync %lu, total %lu",
+	           ITCM_HOT_CODE ? "ITCM" : "flash",
+	           cycles[static_cast<size_t>(Telemetry::Stage::Map)],
+	           cycles[static_cast<size_t>(Telemetry::Stage::WriteColors)],
+	           cycles[static_cast<size_t>(Telemetry::Stage::Vsync)],
+	           total);
+}
+
+void ReportLinkVerification()
+{
+	for (size_t driver = 0; driver < linkVerifiers.size(); driver++)
+	{
+		const Lp5890::LinkVerifier& linkVerifier = linkVerifiers[driver];
+		ReadbackSlots& slots                     = readbackSlots[driver];
+
+		LOG_BINARY("LED driver %u read-back: %lu probes, %lu mismatches, %lu failed reads",
+		           driver + 1,
+		           linkVerifier.GetProbeCount(),
+		           linkVerifier.GetMismatchCount(),
+		           linkVerifier.GetErrorCount());
+
+		uint32_t diagnosticsSteps      = slots.diagnosticsSteps - slots.reportedDiagnosticsSteps;
+		uint32_t verifierSteps         = slots.verifierSteps - slots.reportedVerifierSteps;
+		slots.reportedDiagnosticsSteps = slots.diagnosticsSteps;
+		slots.reportedVerifierSteps    = slots.verifierSteps;
+
+		// A healthy link gives both of them slots, one without any since the last report is starved
+		bool verifying = linkVerifier.GetOverhead() > 0;
+		if (ledDrivers[driver].get().IsLinkHealthy() && (diagnosticsSteps == 0 || (verifying && verifierSteps == 0)))
+			LOG_BINARY("LED driver %u read slots starved: %lu diagnostics, %lu verification", driver + 1, diagnosticsSteps, verifierSteps);
+	}
+}
+
+void ReportBleStatus()
+{
+	tHciPacketPoolStats pool;
+	hci_packet_pool_get_stats(&pool);
+
+	LOG_BINARY("HCI packet pool: %u in use, %u queued, high water %u, %lu allocated, %lu overflows, %lu dropped",
+	           pool.in_use,
+	           pool.queued,
+	           pool.high_water,
+	           pool.allocated,
+	           pool.overflows,
+	           pool.dropped);
+
+	const BLE_NotifyStats_t* notify = BLE_GetNotifyStats();
+
+	LOG_BINARY("BLE notifications: %u queued, high water %u, %lu sent, %lu failed, %lu dropped",
+	           BLE_GetNotifyQueueDepth(),
+	           notify->high_water,
+	           notify->sent,
+	           notify->failed,
+	           notify->dropped);
 }
 
 void InitializeCubeAnimation()
@@ -262,12 +599,49 @@ extern "C" void SetRainbowPresetColors()
 	triangleMesh.AllocateColors(colors);
 }
 
+/**
+ * @brief Configure the DMA stream that drains the stdout buffer to USART1
+ *
+ * @return bool true if the stream was configured, false to fall back to blocking output
+ */
+bool InitStdoutDma()
+{
+	__HAL_RCC_DMA1_CLK_ENABLE();
+
+	hdma_usart1_tx.Instance                 = DMA1_Stream2;
+	hdma_usart1_tx.Init.Request             = DMA_REQUEST_USART1_TX;
+	hdma_usart1_tx.Init.Direction           = DMA_MEMORY_TO_PERIPH;
+	hdma_usart1_tx.Init.PeriphInc           = DMA_PINC_DISABLE;
+	hdma_usart1_tx.Init.MemInc              = DMA_MINC_ENABLE;
+	hdma_usart1_tx.Init.PeriphDataAlignment = DMA_PDATAALIGN_BYTE;
+	hdma_usart1_tx.Init.MemDataAlignment    = DMA_MDATAALIGN_BYTE;
+	hdma_usart1_tx.Init.Mode                = DMA_NORMAL;
+	hdma_usart1_tx.Init.Priority            = DMA_PRIORITY_LOW;
+	hdma_usart1_tx.Init.FIFOMode            = DMA_FIFOMODE_DISABLE;
+	if (HAL_DMA_Init(&hdma_usart1_tx) != HAL_OK)
+		return false;
+
+	__HAL_LINKDMA(&huart1, hdmatx, hdma_usart1_tx);
+
+	// Below the BLE and timer interrupts, logging never delays them
+	HAL_NVIC_SetPriority(DMA1_Stream2_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(DMA1_Stream2_IRQn);
+	HAL_NVIC_SetPriority(USART1_IRQn, 5, 0);
+	HAL_NVIC_EnableIRQ(USART1_IRQn);
+
+	return true;
+}
+
 void setup()
 {
 	NVIC_DisableIRQ(BLE_EXTI_EXTI_IRQn); // Disable to prevent some weird behavior during startup
 
+	bool stdoutDma = InitStdoutDma();
 	SyscallUARTRetarget(&huart1, 100, nullptr, nullptr);
 
+	if (!stdoutDma)
+		puts("Stdout DMA initialization failed, output is blocking");
+
 	puts(CLEAR_BUFFER CLEAR_SCREEN CURSOR_HOME "Hello World!\n");
 
 	// Initialize the scheduler
@@ -288,9 +662,19 @@ void setup()
 		Error_Handler();
 	}
 
+	InterruptQueue::SetTimeSource(&hpCounter);
+	BinaryLog::SetTimeSource(&hpCounter);
+	Telemetry::EnableCycleCounter();
+
 	// Enable the 3.8V and 2.8V regulators
 	REG_EN_GPIO_Port->BSRR = REG_EN_Pin;
 
+	// The LED driver links run on their SPI interrupts while a frame is written, ahead of BLE and logging
+	HAL_NVIC_SetPriority(SPI2_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(SPI2_IRQn);
+	HAL_NVIC_SetPriority(SPI3_IRQn, 3, 0);
+	HAL_NVIC_EnableIRQ(SPI3_IRQn);
+
 	puts("\nInitializing LP5899 1...");
 	if (if1.Init(hpCounter))
 		puts("LP5899 1 initialized successfully");
@@ -335,6 +719,17 @@ void setup()
 		Error_Handler();
 	}
 
+	// Run the CCSI links at the highest rate they hold without errors, later boots only validate the stored rate
+	ErrorMessage::ClearMessage();
+	puts("\nConfiguring CCSI link rate...");
+	if (!linkTraining.TryConfigure(linkTrainingFrames))
+	{
+		puts("CCSI link training failed");
+		ErrorMessage::PrintMessage();
+	}
+
+	InitializeDiagnostics();
+
 
 
 	// size_t a = 0;
@@ -378,6 +773,21 @@ void setup()
 	// Bluetooth
 	MX_BlueNRG_2_Init();
 
+	// Report telemetry once a second
+	scheduler.AddTask(SendTelemetry, 1.0f, 0.0f, true, InterruptQueue::Priority::Low, 200);
+
+	// Send a page of the failed voxel list once a second
+	scheduler.AddTask(SendDiagnostics, 1.0f, 0.5f, true, InterruptQueue::Priority::Low, 200);
+
+	// Report the cycle profile every 10 seconds, compared between builds by `tools/compare_profiles.py`
+	scheduler.AddTask(ReportCycleProfile, 10.0f, 0.0f, true, InterruptQueue::Priority::Low, 200);
+
+	// Report the link verification statistics every 10 seconds
+	scheduler.AddTask(ReportLinkVerification, 10.0f, 5.0f, true, InterruptQueue::Priority::Low, 200);
+
+	// Report the HCI packet pool and BLE notification queue statistics every 10 seconds
+	scheduler.AddTask(ReportBleStatus, 10.0f, 2.5f, true, InterruptQueue::Priority::Low, 200);
+
 	// Turn on the green LED
 	GPIOC->MODER &= ~(0b11 << (14 * 2)); // Clear mode bits for pin 14
 	GPIOC->MODER |= (0b01 << (14 * 2));  // Set pin 14 to output mode
@@ -390,11 +800,15 @@ extern "C" void run()
 
 	std::array<std::reference_wrapper<std::array<float, 512>>, 3> colors = { std::ref(red), std::ref(green), std::ref(blue) };
 
+	pacedDisplayPeriod   = ledDriver1.GetDisplayPeriod();
+	uint32_t framePeriod = framePacer.Configure(targetFrameRate, pacedDisplayPeriod, renderBudget, transmitBudget);
+	printf("Frame period: %lu us\n", framePeriod);
+
+	bool vsyncPending = false;
+
 	constexpr float timeScale = 1000000.0f;
 	while (true)
 	{
-		InterruptQueue::HandleQueue();
-
 		// float time = hpCounter.GetCount() / timeScale;
 		// float sin = std::sin(time);
 		// float cos = std::cos(time);
@@ -413,9 +827,17 @@ extern "C" void run()
 		// green.fill(1.0f);
 		// blue.fill(1.0f);
 
-		UpdateDisplay();
+		RenderFrame(vsyncPending);
+		ServiceDrivers();
+		RunDiagnostics();
 
-		MX_BlueNRG_2_Process();
+		// The rest of the frame is spent on deferred work and BLE
+		do
+		{
+			InterruptQueue::HandleQueue(framePacer.GetFrameDeadline());
+
+			MX_BlueNRG_2_Process();
+		} while (!framePacer.IsFrameDue());
 	}
 }
 
@@ -428,14 +850,33 @@ extern "C" void TIM6_DAC_IRQHandler(void)
 	}
 }
 
+extern "C" void DMA1_Stream2_IRQHandler(void)
+{
+	HAL_DMA_IRQHandler(&hdma_usart1_tx);
+}
+
+extern "C" void USART1_IRQHandler(void)
+{
+	HAL_UART_IRQHandler(&huart1);
+}
+
+extern "C" void SPI2_IRQHandler(void)
+{
+	HAL_SPI_IRQHandler(&hspi2);
+}
+
+extern "C" void SPI3_IRQHandler(void)
+{
+	HAL_SPI_IRQHandler(&hspi3);
+}
+
 extern "C" void TIM7_IRQHandler(void)
 {
 	uint32_t sr = TIM7->SR;
-	if (TIM7->SR & TIM_SR_UIF)
+	if (sr & TIM_SR_UIF)
 	{
+		// Clear the flag first, the update may shorten the period enough for the next one to be raised while handling
+		TIM7->SR = ~TIM_SR_UIF;
 		hpCounter.Update(sr);
-		sr &= ~TIM_SR_UIF; // Clear the update interrupt flag
 	}
-
-	TIM7->SR = sr;
 }
@@ -0,0 +1,58 @@
+/**
+ * @file telemetry.cpp
+ * @author Aidan Orr
+ * @brief Frame timing and error statistics reported over BLE
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ */
+
+#include "telemetry.hpp"
+
+#include <malloc.h>
+
+using namespace LumiVoxel;
+
+Telemetry::Packet Telemetry::Sample(uint32_t crcErrors, uint32_t ccsiErrors, uint8_t bleQueueDepth, uint32_t missedDeadlines)
+{
+	uint64_t now    = counter.GetCount();
+	uint64_t window = now - windowStart;
+
+	Packet packet          = {};
+	packet.Version         = PacketVersion;
+	packet.BleQueueDepth   = bleQueueDepth;
+	packet.CrcErrors       = Saturate(crcErrors);
+	packet.CcsiErrors      = Saturate(ccsiErrors);
+	packet.MissedDeadlines = Saturate(missedDeadlines);
+
+	// The arena only grows, so it is the heap high-water mark
+	packet.HeapHighWater = static_cast<uint32_t>(mallinfo().arena);
+
+	if (window > 0)
+		packet.FrameRate = Saturate(static_cast<uint64_t>(frameCount) * 10 * 1000000 / window);
+
+	for (size_t i = 0; i < StageCount; i++)
+		packet.StageTimes[i] = frameCount > 0 ? Saturate(stageTotals[i] / frameCount) : 0;
+
+	windowStart = now;
+	frameCount  = 0;
+	stageTotals.fill(0);
+
+	return packet;
+}
+
+std::array<uint32_t, Telemetry::StageCount> Telemetry::SampleCycles()
+{
+	std::array<uint32_t, StageCount> cycles = { 0 };
+
+	if (cycleFrameCount > 0)
+	{
+		for (size_t i = 0; i < StageCount; i++)
+			cycles[i] = static_cast<uint32_t>(stageCycles[i] / cycleFrameCount);
+	}
+
+	cycleFrameCount = 0;
+	stageCycles.fill(0);
+
+	return cycles;
+}
@@ -91,6 +91,19 @@ Reset_Handler:
 	ldr r1, =_ebss
 	bl ZeroRamSection
 
+/* Zero fill the DMA buffer sections. */
+	ldr r0, =_sdma_buffer
+	ldr r1, =_edma_buffer
+	bl ZeroRamSection
+
+	ldr r0, =_sram_d2_data
+	ldr r1, =_eram_d2_data
+	bl ZeroRamSection
+
+	ldr r0, =_sram_d3_data
+	ldr r1, =_eram_d3_data
+	bl ZeroRamSection
+
 /* Call static constructors */
 	bl __libc_init_array
 /* Call the application's entry point.*/
@@ -19,6 +19,8 @@
 #include "hci_const.h"
 #include "hci.h"
 #include "hci_tl.h"
+#include "critical_section.h"
+#include "memory_regions.h"
 
 #define HCI_LOG_ON                      0
 #define HCI_PCK_TYPE_OFFSET             0
@@ -39,10 +41,20 @@
   #define MAX(a,b)      ((a) > (b))? (a) : (b)
 #endif
 
-tListNode             hciReadPktPool;
-tListNode             hciReadPktRxQueue;
-static tHciDataPacket hciReadPacketBuffer[HCI_READ_PACKET_NUM_MAX];
-static tHciContext    hciContext;
+/**
+ * Fixed-block packet pool. Free packets are kept as a stack of indices, received
+ * packets as a ring of pointers so that unrelated events seen while waiting for a
+ * command response can be put back at the front without moving the data. SPI DMA
+ * reads events straight into the packets, so the pool sits in non-cacheable D2 SRAM.
+ */
+static tHciDataPacket      hciReadPacketBuffer[HCI_READ_PACKET_NUM_MAX] DMA_BUFFER_D2;
+static uint8_t             hciFreeStack[HCI_READ_PACKET_NUM_MAX];
+static volatile uint8_t    hciFreeCount;
+static tHciDataPacket*     hciRxQueue[HCI_READ_PACKET_NUM_MAX];
+static volatile uint8_t    hciRxQueueHead;
+static volatile uint8_t    hciRxQueueCount;
+static tHciPacketPoolStats hciPoolStats;
+static tHciContext         hciContext;
 
 /************************* Static internal functions **************************/
 
@@ -93,26 +105,64 @@ static void send_cmd(uint16_t ogf, uint16_t ocf, uint8_t plen, void *param)
 }
 
 /**
-  * @brief  Remove the tail from a source list and insert it to the head 
-  *         of a destination list.
+  * @brief  Append a packet to the receive queue.
   *
-  * @param  dest_list
-  * @param  src_list
+  * @param  packet The packet
   * @retval None
   */
-static void move_list(tListNode * dest_list, tListNode * src_list)
+static void rx_queue_push_back(tHciDataPacket * packet)
 {
-  pListNode tmp_node;
-  
-  while (!list_is_empty(src_list))
+  uint32_t primask = EnterCriticalSection();
+
+  hciRxQueue[(hciRxQueueHead + hciRxQueueCount) % HCI_READ_PACKET_NUM_MAX] = packet;
+  hciRxQueueCount++;
+
+  ExitCriticalSection(primask);
+}
+
+/**
+  * @brief  Put a packet back at the front of the receive queue.
+  *
+  * @param  packet The packet
+  * @retval None
+  */
+static void rx_queue_push_front(tHciDataPacket * packet)
+{
+  uint32_t primask = EnterCriticalSection();
+
+  hciRxQueueHead = (hciRxQueueHead + HCI_READ_PACKET_NUM_MAX - 1) % HCI_READ_PACKET_NUM_MAX;
+  hciRxQueue[hciRxQueueHead] = packet;
+  hciRxQueueCount++;
+
+  ExitCriticalSection(primask);
+}
+
+/**
+  * @brief  Take the oldest packet from the receive queue.
+  *
+  * @param  None
+  * @retval tHciDataPacket*: The packet, NULL if the queue is empty
+  */
+static tHciDataPacket * rx_queue_pop_front(void)
+{
+  tHciDataPacket * packet = NULL;
+  uint32_t primask = EnterCriticalSection();
+
+  if (hciRxQueueCount > 0)
   {
-    list_remove_tail(src_list, &tmp_node);
-    list_insert_head(dest_list, tmp_node);
+    packet = hciRxQueue[hciRxQueueHead];
+    hciRxQueueHead = (hciRxQueueHead + 1) % HCI_READ_PACKET_NUM_MAX;
+    hciRxQueueCount--;
   }
+
+  ExitCriticalSection(primask);
+  return packet;
 }
 
 /**
   * @brief  Free the HCI event list.
+  *         Discards the oldest events until half of the pool is free, so that
+  *         the response to a command can always be read.
   *
   * @param  None
   * @retval None
@@ -121,9 +171,14 @@ static void free_event_list(void)
 {
   tHciDataPacket * pckt;
 
-  while(list_get_size(&hciReadPktPool) < HCI_READ_PACKET_NUM_MAX/2){
-    list_remove_head(&hciReadPktRxQueue, (tListNode **)&pckt);    
-    list_insert_tail(&hciReadPktPool, (tListNode *)pckt);
+  while (hciFreeCount < HCI_READ_PACKET_NUM_MAX/2)
+  {
+    pckt = rx_queue_pop_front();
+    if (pckt == NULL)
+      break;
+
+    hciPoolStats.dropped++;
+    hci_packet_release(pckt);
   }
 }
 
@@ -138,18 +193,18 @@ void hci_init(void(* UserEvtRx)(void* pData), void* pConf)
     hciContext.UserEvtRx = UserEvtRx;
   }
   
-  /* Initialize list heads of ready and free hci data packet queues */
-  list_init_head(&hciReadPktPool);
-  list_init_head(&hciReadPktRxQueue);
+  /* Initialize the pool of free hci data packets and the queue of ready ones */
+  for (index = 0; index < HCI_READ_PACKET_NUM_MAX; index++)
+  {
+    hciReadPacketBuffer[index].ref_count = 0;
+    hciFreeStack[index] = index;
+  }
+  hciFreeCount    = HCI_READ_PACKET_NUM_MAX;
+  hciRxQueueHead  = 0;
+  hciRxQueueCount = 0;
 
   /* Initialize TL BLE layer */
   hci_tl_lowlevel_init();
-
-  /* Initialize the queue of free hci data packets */
-  for (index = 0; index < HCI_READ_PACKET_NUM_MAX; index++)
-  {
-    list_insert_tail(&hciReadPktPool, (tListNode *)&hciReadPacketBuffer[index]);
-  } 
   
   /* Initialize low level driver */
   if (hciContext.io.Init)  hciContext.io.Init(NULL);
@@ -166,6 +221,65 @@ void hci_register_io_bus(tHciIO* fops)
   hciContext.io.Reset   = fops->Reset;
 }
 
+tHciDataPacket* hci_packet_alloc(void)
+{
+  tHciDataPacket * packet = NULL;
+  uint32_t primask = EnterCriticalSection();
+
+  if (hciFreeCount > 0)
+  {
+    packet = &hciReadPacketBuffer[hciFreeStack[--hciFreeCount]];
+    packet->ref_count = 1;
+    packet->data_len  = 0;
+
+    hciPoolStats.allocated++;
+    if (HCI_READ_PACKET_NUM_MAX - hciFreeCount > hciPoolStats.high_water)
+    {
+      hciPoolStats.high_water = HCI_READ_PACKET_NUM_MAX - hciFreeCount;
+    }
+  }
+  else
+  {
+    hciPoolStats.overflows++;
+  }
+
+  ExitCriticalSection(primask);
+  return packet;
+}
+
+void hci_packet_release(tHciDataPacket* packet)
+{
+  uint32_t primask = EnterCriticalSection();
+
+  if (packet->ref_count > 0 && --packet->ref_count == 0)
+  {
+    hciFreeStack[hciFreeCount++] = (uint8_t)(packet - hciReadPacketBuffer);
+  }
+
+  ExitCriticalSection(primask);
+}
+
+uint8_t hci_packet_pool_free(void)
+{
+  return hciFreeCount;
+}
+
+uint8_t hci_packet_rx_queue_size(void)
+{
+  return hciRxQueueCount;
+}
+
+void hci_packet_pool_get_stats(tHciPacketPoolStats* stats)
+{
+  uint32_t primask = EnterCriticalSection();
+
+  *stats        = hciPoolStats;
+  stats->in_use = HCI_READ_PACKET_NUM_MAX - hciFreeCount;
+  stats->queued = hciRxQueueCount;
+
+  ExitCriticalSection(primask);
+}
+
 int hci_send_req(struct hci_request* r, BOOL async)
 {
   uint8_t *ptr;
@@ -174,9 +288,8 @@ int hci_send_req(struct hci_request* r, BOOL async)
   hci_spi_pckt *hci_hdr;
 
   tHciDataPacket * hciReadPacket = NULL;
-  tListNode hciTempQueue;
-  
-  list_init_head(&hciTempQueue);
+  tHciDataPacket * hciTempQueue[HCI_READ_PACKET_NUM_MAX];
+  uint8_t hciTempCount = 0;
 
   free_event_list();
   
@@ -203,15 +316,14 @@ int hci_send_req(struct hci_request* r, BOOL async)
         goto failed;
       }
       
-      if (!list_is_empty(&hciReadPktRxQueue)) 
+      /* Extract packet from HCI event queue. */
+      hciReadPacket = rx_queue_pop_front();
+      if (hciReadPacket != NULL)
       {
         break;
       }
     }
     
-    /* Extract packet from HCI event queue. */
-    list_remove_head(&hciReadPktRxQueue, (tListNode **)&hciReadPacket);    
-    
     hci_hdr = (void *)hciReadPacket->dataBuff;
 
     if (hci_hdr->type == HCI_EVENT_PKT)
@@ -276,32 +388,37 @@ int hci_send_req(struct hci_request* r, BOOL async)
        packet in the pool to process the expected event.
        If no free packets are available, discard the processed event and insert it
        into the pool. */
-    if (list_is_empty(&hciReadPktPool) && list_is_empty(&hciReadPktRxQueue)) {
-      list_insert_tail(&hciReadPktPool, (tListNode *)hciReadPacket);
+    if (hciFreeCount == 0 && hciRxQueueCount == 0) {
+      hciPoolStats.dropped++;
+      hci_packet_release(hciReadPacket);
       hciReadPacket=NULL;
     }
     else {
-      /* Insert the packet in a different queue. These packets will be
-      inserted back in the main queue just before exiting from send_req(), so that
-      these events can be processed by the application.
+      /* Keep a handle to the packet in a different queue. These packets will be
+      put back at the front of the main queue just before exiting from send_req(),
+      so that these events can be processed by the application.
     */
-    list_insert_tail(&hciTempQueue, (tListNode *)hciReadPacket);
+    hciTempQueue[hciTempCount++] = hciReadPacket;
       hciReadPacket=NULL;
     }
   }
   
 failed: 
   if (hciReadPacket!=NULL) {
-    list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);
+    hci_packet_release(hciReadPacket);
+  }
+  while (hciTempCount > 0) {
+    rx_queue_push_front(hciTempQueue[--hciTempCount]);
   }
-  move_list(&hciReadPktRxQueue, &hciTempQueue);
 
   return -1;
   
 done:
-  /* Insert the packet back into the pool.*/
-  list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket); 
-  move_list(&hciReadPktRxQueue, &hciTempQueue);
+  /* Return the packet to the pool.*/
+  hci_packet_release(hciReadPacket);
+  while (hciTempCount > 0) {
+    rx_queue_push_front(hciTempQueue[--hciTempCount]);
+  }
 
   return 0;
 }
@@ -311,48 +428,48 @@ void hci_user_evt_proc(void)
   tHciDataPacket * hciReadPacket = NULL;
      
   /* process any pending events read */
-  while (list_is_empty(&hciReadPktRxQueue) == FALSE)
+  while ((hciReadPacket = rx_queue_pop_front()) != NULL)
   {
-    list_remove_head (&hciReadPktRxQueue, (tListNode **)&hciReadPacket);
-
+    /* The callback gets the pool block itself, the block returns to the pool when the callback returns */
     if (hciContext.UserEvtRx != NULL)
     {
       hciContext.UserEvtRx(hciReadPacket->dataBuff);
     }
 
-    list_insert_tail(&hciReadPktPool, (tListNode *)hciReadPacket);
+    hci_packet_release(hciReadPacket);
   }
 }
 
 int32_t hci_notify_asynch_evt(void* pdata)
 {
-  tHciDataPacket * hciReadPacket = NULL;
+  tHciDataPacket * hciReadPacket = pdata;
   uint8_t data_len;
   
   int32_t ret = 0;
-  
-  if (list_is_empty (&hciReadPktPool) == FALSE)
+
+  if (hciReadPacket != NULL)
+  {
+    /* Packet already filled in place by the transport */
+    if (hciReadPacket->data_len > 0 && verify_packet(hciReadPacket) == 0)
+      rx_queue_push_back(hciReadPacket);
+    else
+      hci_packet_release(hciReadPacket);
+  }
+  else if ((hciReadPacket = hci_packet_alloc()) != NULL)
   {
     /* Queuing a packet to read */
-    list_remove_head (&hciReadPktPool, (tListNode **)&hciReadPacket);
-    
+    data_len = 0;
     if (hciContext.io.Receive)
     {
       data_len = hciContext.io.Receive(hciReadPacket->dataBuff, HCI_READ_PACKET_SIZE);
-      if (data_len > 0)
-      {                    
-        hciReadPacket->data_len = data_len;
-        if (verify_packet(hciReadPacket) == 0)
-          list_insert_tail(&hciReadPktRxQueue, (tListNode *)hciReadPacket);
-        else
-          list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);          
-      }
-      else 
-      {
-        /* Insert the packet back into the pool*/
-        list_insert_head(&hciReadPktPool, (tListNode *)hciReadPacket);
-      }
     }
+
+    hciReadPacket->data_len = data_len;
+    if (data_len > 0 && verify_packet(hciReadPacket) == 0)
+      rx_queue_push_back(hciReadPacket);
+    else
+      /* Insert the packet back into the pool*/
+      hci_packet_release(hciReadPacket);
   }
   else 
   {
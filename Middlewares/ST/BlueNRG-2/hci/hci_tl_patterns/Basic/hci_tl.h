@@ -60,15 +60,34 @@ struct hci_request {
  */
  
 /**
- * @brief Structure used to read received HCI data packet
+ * @brief Structure used to read received HCI data packet.
+ *        Packets are fixed blocks of the HCI packet pool, the data buffer
+ *        is cache line aligned so the transport can DMA straight into it.
  * @{
  */
 typedef struct _tHciDataPacket
 {
-  tListNode currentNode;
-  uint8_t dataBuff[HCI_READ_PACKET_SIZE];
-  uint8_t data_len;
-} tHciDataPacket;
+  uint8_t dataBuff[HCI_READ_PACKET_SIZE]; /**< Raw HCI packet, starting with the packet type */
+  uint8_t data_len;                       /**< Number of valid bytes in dataBuff */
+  volatile uint8_t ref_count;             /**< Number of holders, the packet returns to the pool at 0 */
+} __attribute__((aligned(32))) tHciDataPacket;
+/**
+ * @}
+ */
+
+/**
+ * @brief Occupancy and overflow counters of the HCI packet pool
+ * @{
+ */
+typedef struct
+{
+  uint32_t allocated;  /**< Packets taken from the pool */
+  uint32_t overflows;  /**< Allocations that failed because the pool was empty */
+  uint32_t dropped;    /**< Queued events discarded to make room for a command response */
+  uint8_t  in_use;     /**< Packets currently held */
+  uint8_t  queued;     /**< Packets waiting to be processed */
+  uint8_t  high_water; /**< Highest number of packets held at once */
+} tHciPacketPoolStats;
 /**
  * @}
  */
@@ -186,6 +205,9 @@ void hci_register_io_bus(tHciIO* fops);
  * @brief  Interrupt service routine that must be called when the BlueNRG 
  *         reports a packet received or an event to the host through the 
  *         BlueNRG interrupt line.
+ *         When pdata is NULL the event is read through the Receive IO function,
+ *         otherwise pdata is a packet from hci_packet_alloc() already filled
+ *         by the transport, ownership of its reference is passed to the HCI layer.
  *
  * @param  pdata Packet or event pointer
  * @retval 0: packet/event processed, 1: no packet/event processed
@@ -223,6 +245,49 @@ void hci_cmd_resp_wait(uint32_t timeout);
  */
 void hci_cmd_resp_release(uint32_t flag);
 
+/**
+  * @brief  Take a packet from the HCI packet pool.
+  *         The packet is returned with a reference count of 1.
+  *         Can be called from interrupt context.
+  *
+  * @param  None
+  * @retval tHciDataPacket*: The packet, NULL if the pool is empty
+  */
+tHciDataPacket* hci_packet_alloc(void);
+
+/**
+  * @brief  Drop a reference to a packet, returning it to the pool on the last one.
+  *         Can be called from interrupt context.
+  *
+  * @param  packet: The packet
+  * @retval None
+  */
+void hci_packet_release(tHciDataPacket* packet);
+
+/**
+  * @brief  Get the number of free packets in the HCI packet pool.
+  *
+  * @param  None
+  * @retval uint8_t: Number of free packets
+  */
+uint8_t hci_packet_pool_free(void);
+
+/**
+  * @brief  Get the number of received packets waiting to be processed.
+  *
+  * @param  None
+  * @retval uint8_t: Number of queued packets
+  */
+uint8_t hci_packet_rx_queue_size(void);
+
+/**
+  * @brief  Get the occupancy and overflow counters of the HCI packet pool.
+  *
+  * @param  stats: Filled with the current counters
+  * @retval None
+  */
+void hci_packet_pool_get_stats(tHciPacketPoolStats* stats);
+
 /**
  * @}
  */
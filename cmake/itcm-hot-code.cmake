@@ -0,0 +1,42 @@
+# Relocation of hot functions from flash into ITCM
+#
+# The hot functions are listed in the .itcmram output section of the linker script, between the "ITCM hot code begin"
+# and "ITCM hot code end" comments, as input section patterns matched against the mangled names of the function
+# sections (-ffunction-sections), so templates and functions from any object file, including LTO partitions, can be
+# listed. Keeping the list in the script lets the STM32CubeIDE build link it as is. With ITCM_HOT_CODE off a copy of the
+# script without the list is generated into the build directory and linked instead, so the functions stay in flash and
+# the two placements can be compared with the cycle profile printed by the firmware.
+
+option(ITCM_HOT_CODE "Place the functions listed in the linker script's ITCM hot code block in ITCM" ON)
+
+function(add_itcm_hot_code TARGET_NAME)
+    target_compile_definitions(${TARGET_NAME} PRIVATE "ITCM_HOT_CODE=$<BOOL:${ITCM_HOT_CODE}>")
+
+    if(ITCM_HOT_CODE)
+        return()
+    endif()
+
+    set(SCRIPT "${PROJECT_SOURCE_DIR}/STM32H725RGVX_FLASH.ld")
+    set(STRIPPED "${CMAKE_BINARY_DIR}/STM32H725RGVX_FLASH.ld")
+
+    file(READ "${SCRIPT}" CONTENTS)
+    string(REGEX REPLACE "[ \t]*/\\* ITCM hot code begin.*/\\* ITCM hot code end \\*/\n" "" STRIPPED_CONTENTS "${CONTENTS}")
+    if(STRIPPED_CONTENTS STREQUAL CONTENTS)
+        message(FATAL_ERROR "No ITCM hot code block found in ${SCRIPT}")
+    endif()
+
+    # Only replaced when it changed, so configuring again does not relink
+    file(WRITE "${STRIPPED}.tmp" "${STRIPPED_CONTENTS}")
+    configure_file("${STRIPPED}.tmp" "${STRIPPED}" COPYONLY)
+    set_property(DIRECTORY APPEND PROPERTY CMAKE_CONFIGURE_DEPENDS "${SCRIPT}")
+
+    # Link the stripped copy in place of the script set by add_st_target_properties
+    get_target_property(OPTIONS ${TARGET_NAME} LINK_OPTIONS)
+    set(REPLACED_OPTIONS "")
+    foreach(OPTION IN LISTS OPTIONS)
+        string(REPLACE "${SCRIPT}" "${STRIPPED}" OPTION "${OPTION}")
+        list(APPEND REPLACED_OPTIONS "${OPTION}")
+    endforeach()
+    set_target_properties(${TARGET_NAME} PROPERTIES LINK_OPTIONS "${REPLACED_OPTIONS}")
+    set_property(TARGET ${TARGET_NAME} APPEND PROPERTY LINK_DEPENDS "${STRIPPED}")
+endfunction()
@@ -147,18 +147,28 @@ target_link_options(
 
 target_sources(
     ${TARGET_NAME} PRIVATE
+    "lib\\common-lib\\src\\binary_log.cpp"
     "lib\\common-lib\\src\\errors.cpp"
+    "lib\\common-lib\\src\\flash_store.cpp"
     "lib\\common-lib\\src\\high_precision_counter.cpp"
     "lib\\common-lib\\src\\interrupt_queue.cpp"
+    "lib\\common-lib\\src\\memory_regions.c"
     "lib\\common-lib\\src\\scheduler.cpp"
     "lib\\common-lib\\src\\syscall_retarget.cpp"
     "lib\\common-lib\\src\\timer_helpers.c"
+    "lib\\common-lib\\src\\timer_wheel.cpp"
     "lib\\TriangleMesh\\meshwrapper.cpp"
     "BlueNRG_2\\App\\app_bluenrg_2.c"
     "BlueNRG_2\\App\\gatt_db.c"
     "BlueNRG_2\\Target\\hci_tl_interface.c"
     "Core\\Src\\custom_bus.c"
+    "Core\\Src\\frame_pacer.cpp"
     "Core\\Src\\lp5890.cpp"
+    "Core\\Src\\lp5890_brightness.cpp"
+    "Core\\Src\\lp5890_diagnostics.cpp"
+    "Core\\Src\\lp5890_frame_transmitter.cpp"
+    "Core\\Src\\lp5890_link_training.cpp"
+    "Core\\Src\\lp5890_link_verifier.cpp"
     "Core\\Src\\lp5899.cpp"
     "Core\\Src\\main.c"
     "Core\\Src\\run.cpp"
@@ -167,6 +177,7 @@ target_sources(
     "Core\\Src\\syscalls.c"
     "Core\\Src\\sysmem.c"
     "Core\\Src\\system_stm32h7xx.c"
+    "Core\\Src\\telemetry.cpp"
     "Core\\Startup\\startup_stm32h725rgvx.s"
     "Middlewares\\ST\\BlueNRG-2\\hci\\bluenrg1_devConfig.c"
     "Middlewares\\ST\\BlueNRG-2\\hci\\bluenrg1_events_cb.c"
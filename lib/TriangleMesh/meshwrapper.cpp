@@ -16,13 +16,84 @@ extern float brightness;
 
 extern "C" void SetRainbowPresetColors();
 
+/// @brief Format byte prefixed to compact wire encodings, legacy float writes carry no format byte
+enum struct WireFormat : uint8_t
+{
+	TransformQuatTranslation16      = 0x01, ///< @brief Quaternion (w, x, y, z) in Q14 followed by translation (x, y, z) in Q12, all int16
+	TransformQuatTranslationScale16 = 0x02, ///< @brief As TransformQuatTranslation16 followed by a uniform scale in Q12
+	VertsNormalized8                = 0x10, ///< @brief Vertices as 3 x int8 normalized to [-1, 1]
+	VertsNormalized16               = 0x11, ///< @brief Vertices as 3 x int16 normalized to [-1, 1]
+};
+
+static constexpr size_t LegacyTransformSize  = 16 * sizeof(float);
+static constexpr size_t LegacyVertexSize     = 3 * sizeof(float);
+static constexpr float QuaternionScale       = 1.0f / (1 << 14);
+static constexpr float TranslationScale      = 1.0f / (1 << 12);
+static constexpr size_t CompactTransformSize = 1 + 7 * sizeof(int16_t);
+
+/// @brief Reads a little-endian int16 from a possibly unaligned buffer
+static inline int16_t ReadInt16(const uint8_t* data)
+{
+	return (int16_t)(data[0] | (data[1] << 8));
+}
+
+/**
+ * @brief Builds a rigid transform from a quantized quaternion, translation and optional uniform scale
+ *
+ * @param data Payload following the format byte
+ * @param hasScale Whether a scale follows the translation
+ * @param transform Resulting transform
+ * @return Whether the quaternion was valid
+ */
+static bool DecodeCompactTransform(const uint8_t* data, bool hasScale, Eigen::Matrix4f& transform)
+{
+	float w = ReadInt16(data + 0) * QuaternionScale;
+	float x = ReadInt16(data + 2) * QuaternionScale;
+	float y = ReadInt16(data + 4) * QuaternionScale;
+	float z = ReadInt16(data + 6) * QuaternionScale;
+
+	// Renormalize to remove quantization error
+	float norm = w * w + x * x + y * y + z * z;
+	if (norm <= 0.0f)
+	{
+		return false;
+	}
+
+	float s     = 2.0f / norm;
+	float scale = hasScale ? ReadInt16(data + 14) * TranslationScale : 1.0f;
+
+	transform << (1.0f - s * (y * y + z * z)) * scale, s * (x * y - w * z) * scale, s * (x * z + w * y) * scale, ReadInt16(data + 8) * TranslationScale,
+		s * (x * y + w * z) * scale, (1.0f - s * (x * x + z * z)) * scale, s * (y * z - w * x) * scale, ReadInt16(data + 10) * TranslationScale,
+		s * (x * z - w * y) * scale, s * (y * z + w * x) * scale, (1.0f - s * (x * x + y * y)) * scale, ReadInt16(data + 12) * TranslationScale,
+		0.0f, 0.0f, 0.0f, 1.0f;
+
+	return true;
+}
+
 extern "C" bool meshTransform(uint8_t* data_buffer, uint8_t Nb_bytes)
 {
 	Eigen::Matrix4f transform;
 
-	for (int i = 0; i < 16; i++)
+	if (Nb_bytes == LegacyTransformSize)
 	{
-		transform((int)(i / 4), i % 4) = *((float*)data_buffer + i);
+		for (int i = 0; i < 16; i++)
+		{
+			transform((int)(i / 4), i % 4) = *((float*)data_buffer + i);
+		}
+	}
+	else if (Nb_bytes == CompactTransformSize && data_buffer[0] == (uint8_t)WireFormat::TransformQuatTranslation16)
+	{
+		if (!DecodeCompactTransform(data_buffer + 1, false, transform))
+			return false;
+	}
+	else if (Nb_bytes == CompactTransformSize + sizeof(int16_t) && data_buffer[0] == (uint8_t)WireFormat::TransformQuatTranslationScale16)
+	{
+		if (!DecodeCompactTransform(data_buffer + 1, true, transform))
+			return false;
+	}
+	else
+	{
+		return false;
 	}
 
 	triangleMesh.Transform(transform);
@@ -43,7 +114,50 @@ extern "C" bool meshTris(uint8_t* data_buffer, uint8_t Nb_bytes)
 
 extern "C" bool meshVerts(uint8_t* data_buffer, uint8_t Nb_bytes)
 {
-	return triangleMesh.AllocateVerts(std::span<float>{ (float*)data_buffer, Nb_bytes / sizeof(float) });
+	// Legacy writes are whole float triples, compact writes are a format byte followed by whole triples
+	if (Nb_bytes % LegacyVertexSize == 0)
+	{
+		return triangleMesh.AllocateVerts(std::span<float>{ (float*)data_buffer, Nb_bytes / sizeof(float) });
+	}
+
+	std::array<float, UINT8_MAX> coordinates;
+	size_t coordinateCount;
+
+	uint8_t* payload   = data_buffer + 1;
+	size_t payloadSize = Nb_bytes - 1;
+
+	switch ((WireFormat)data_buffer[0])
+	{
+	case WireFormat::VertsNormalized8:
+		if (payloadSize % 3 != 0)
+			return false;
+
+		coordinateCount = payloadSize;
+		for (size_t i = 0; i < coordinateCount; i++)
+		{
+			coordinates[i] = (int8_t)payload[i] * (1.0f / INT8_MAX);
+		}
+		break;
+	case WireFormat::VertsNormalized16:
+		if (payloadSize % (3 * sizeof(int16_t)) != 0)
+			return false;
+
+		coordinateCount = payloadSize / sizeof(int16_t);
+		for (size_t i = 0; i < coordinateCount; i++)
+		{
+			coordinates[i] = ReadInt16(payload + i * sizeof(int16_t)) * (1.0f / INT16_MAX);
+		}
+		break;
+	default:
+		return false;
+	}
+
+	if (coordinateCount / 3 > triangleMesh.MaxVertexCount())
+	{
+		return false;
+	}
+
+	return triangleMesh.AllocateVerts(std::span<float>{ coordinates.data(), coordinateCount });
 }
 
 static void SetColor(float red, float green, float blue)
@@ -7,10 +7,24 @@
 extern "C" {
 #endif
 
+/**
+ * @brief Applies a transform to the mesh and rasterizes it
+ *
+ * Accepts either the legacy 16 float row-major matrix (64 bytes) or a compact encoding prefixed with a format byte:
+ *   0x01: quaternion (w, x, y, z) int16 Q14, translation (x, y, z) int16 Q12 (15 bytes)
+ *   0x02: as 0x01 followed by a uniform scale int16 Q12 (17 bytes)
+ */
 bool meshTransform(uint8_t* data_buffer, uint8_t Nb_bytes);
 
 bool meshTris(uint8_t* data_buffer, uint8_t Nb_bytes);
 
+/**
+ * @brief Replaces the mesh vertices
+ *
+ * Accepts either legacy float triples (12 bytes per vertex) or a compact encoding prefixed with a format byte:
+ *   0x10: int8 triples normalized to [-1, 1] (3 bytes per vertex)
+ *   0x11: int16 triples normalized to [-1, 1] (6 bytes per vertex)
+ */
 bool meshVerts(uint8_t* data_buffer, uint8_t Nb_bytes);
 
 bool colorMode(uint8_t* data, uint8_t count);
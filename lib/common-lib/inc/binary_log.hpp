@@ -0,0 +1,127 @@
+/**
+ * @file binary_log.hpp
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Deferred binary logging with format strings kept out of the firmware image
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <array>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * @brief Log a message as a binary record, formatted on the host by `tools/log_decoder.py`
+ * @remark The format string is placed in the `.logstr` section, which is kept in the ELF file but not loaded, and its
+ * offset in the section is the ID sent in place of the text. Arguments are sent raw: integers up to 32 bits, 64 bit
+ * integers for `ll` conversions, floating point values as 32 bit floats, and `%s` only for strings stored in the image.
+ *
+ * @param format A printf style format string literal
+ */
+#define LOG_BINARY(format, ...) LOG_BINARY_SECTION(format, LOG_BINARY_STRINGIFY(__COUNTER__) __VA_OPT__(, ) __VA_ARGS__)
+
+// Each format string gets its own section, strings in inline functions are in COMDAT sections that cannot share a section
+#define LOG_BINARY_STRINGIFY_(value) #value
+#define LOG_BINARY_STRINGIFY(value)  LOG_BINARY_STRINGIFY_(value)
+#define LOG_BINARY_SECTION(format, id, ...)                                                                \
+	do                                                                                                     \
+	{                                                                                                      \
+		static const char logFormat[] __attribute__((section(".logstr." id), used, aligned(1))) = format; \
+		::LumiVoxel::BinaryLog::Write(logFormat __VA_OPT__(, ) __VA_ARGS__);                               \
+	} while (0)
+
+namespace LumiVoxel
+{
+
+class HighPrecisionCounter;
+
+/**
+ * @brief Writes log records of a format string ID, a timestamp and raw arguments to stdout
+ * @remark A record is `FrameMarker`, the length of the rest of the record, the 16 bit ID, the 32 bit timestamp in
+ * microseconds and the arguments, all little-endian. The marker never appears in text output, so records and text
+ * can share the UART. Each record is written in a single call into the stdout ring buffer, so records are never split.
+ */
+class BinaryLog
+{
+  public:
+	static constexpr uint8_t FrameMarker  = 0x00;
+	static constexpr size_t MaxArguments  = 8;
+	static constexpr size_t HeaderSize    = 8; ///< @brief Marker, length, ID and timestamp
+	static constexpr size_t MaxRecordSize = HeaderSize + MaxArguments * sizeof(uint64_t);
+
+	static_assert(MaxRecordSize - 2 <= UINT8_MAX, "Record length must fit in a byte");
+
+  private:
+	/// @brief The counter used to timestamp records, `nullptr` for zero timestamps
+	static const HighPrecisionCounter* TimeSource;
+
+	static void Emit(const char* format, uint8_t* record, size_t length) __attribute__((section(".RamFunc")));
+
+	template <typename T>
+	static size_t Encode(uint8_t* buffer, T value)
+	{
+		using D = std::decay_t<T>;
+
+		if constexpr (std::is_floating_point_v<D>)
+			return Store(buffer, std::bit_cast<uint32_t>(static_cast<float>(value)));
+		else if constexpr (std::is_pointer_v<D>)
+			return Store(buffer, static_cast<uint32_t>(reinterpret_cast<uintptr_t>(value)));
+		else if constexpr (std::is_enum_v<D>)
+			return Encode(buffer, static_cast<std::underlying_type_t<D>>(value));
+		else
+		{
+			static_assert(std::is_integral_v<D>, "Binary log arguments must be integers, floating point values or pointers");
+
+			if constexpr (sizeof(D) > sizeof(uint32_t))
+				return Store(buffer, static_cast<uint64_t>(value));
+			else if constexpr (std::is_signed_v<D>)
+				return Store(buffer, static_cast<uint32_t>(static_cast<int32_t>(value)));
+			else
+				return Store(buffer, static_cast<uint32_t>(value));
+		}
+	}
+
+	template <typename T>
+	static size_t Store(uint8_t* buffer, T value)
+	{
+		for (size_t i = 0; i < sizeof(T); i++)
+			buffer[i] = static_cast<uint8_t>(value >> (8 * i));
+
+		return sizeof(T);
+	}
+
+  public:
+	/**
+	 * @brief Set the counter used to timestamp records
+	 *
+	 * @param counter The microsecond counter, `nullptr` for zero timestamps
+	 */
+	static void SetTimeSource(const HighPrecisionCounter* counter) { TimeSource = counter; }
+
+	/**
+	 * @brief Write a record, use `LOG_BINARY` so the format string is placed in the `.logstr` section
+	 * @remark Safe to call from interrupts
+	 *
+	 * @param format The format string in the `.logstr` section
+	 * @param args The arguments of the format string
+	 */
+	template <typename... Args>
+	static void Write(const char* format, Args... args)
+	{
+		static_assert(sizeof...(Args) <= MaxArguments, "Too many binary log arguments");
+
+		std::array<uint8_t, MaxRecordSize> record;
+
+		size_t length = HeaderSize;
+		((length += Encode(&record[length], args)), ...);
+
+		Emit(format, record.data(), length);
+	}
+};
+
+} // namespace LumiVoxel
@@ -9,45 +9,120 @@
  */
 #pragma once
 
-#include <cstring>
-#include <memory>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
 
 namespace LumiVoxel
 {
 
-/// @brief Contains logic for creating and displaying nested error messages
+/**
+ * @brief Contains logic for creating and displaying nested error messages
+ * @remark Errors are kept in a fixed stack of records holding a static message and its numeric arguments. Nothing is
+ * allocated or formatted when an error is set, the message is only formatted when it is read or printed.
+ */
 class ErrorMessage
 {
   public:
+	static constexpr size_t MaxDepth     = 8; ///< @brief Maximum number of nested error records
+	static constexpr size_t MaxArguments = 6; ///< @brief Maximum number of arguments of a single error record
+
+	/**
+	 * @brief Format string of an error record, checked at compile time against its arguments
+	 * @remark Arguments are stored as `unsigned int`, so every conversion must be one of `d i o u x X c` without a
+	 * length modifier, and there must be exactly one conversion for each argument
+	 *
+	 * @tparam Args The argument types
+	 */
+	template <typename... Args>
+	struct FormatString
+	{
+		const char* Value;
+
+		consteval FormatString(const char* message)
+			: Value(message)
+		{
+			if (CountConversions(message) != static_cast<int>(sizeof...(Args)))
+				FormatDoesNotMatchArguments();
+		}
+	};
+
 	/// @brief Structure for a single nested error message
 	struct Error
 	{
-		std::shared_ptr<char[]> Message;
-		std::shared_ptr<Error> InnerError;
-
 		static constexpr const char* EmptyError = "";
 
-		static void EmptyDeleter(char* message) {}
+		const char* Message = EmptyError; ///< @brief Static message, a printf format string when there are arguments
+		uint32_t Code       = 0;          ///< @brief Numeric error code, zero if none
 
-		Error(const char* message, const std::shared_ptr<Error>& innerError)
-			: Message((char*)message, EmptyDeleter), InnerError(innerError)
-		{ }
+		std::array<unsigned int, MaxArguments> Arguments = { 0 }; ///< @brief Arguments of the format string
+		uint8_t ArgumentCount                            = 0;
+	};
 
-		Error(const std::shared_ptr<char[]> message, const std::shared_ptr<Error>& innerError)
-			: Message(message), InnerError(innerError) {}
+  private:
+	static std::array<Error, MaxDepth> errors; ///< @brief Error records, innermost first
+	static size_t depth;                       ///< @brief Number of error records in use
+	static size_t droppedCount;                ///< @brief Number of wrapping records dropped because the stack was full
 
-		Error(const char* message)
-			: Error(message, nullptr) {}
+	/// @brief Not defined, so a format string that fails the check does not compile
+	static void FormatDoesNotMatchArguments();
 
-		Error(const std::shared_ptr<char[]> message)
-			: Error(message, nullptr) {}
-	};
+	/// @brief Count the conversions of a format string, -1 if one of them cannot take an `unsigned int`
+	static consteval int CountConversions(const char* message)
+	{
+		constexpr auto contains = [](const char* set, char c) {
+			for (; *set != '\0'; set++)
+			{
+				if (*set == c)
+					return true;
+			}
+			return false;
+		};
+
+		int count = 0;
+		for (const char* c = message; *c != '\0'; c++)
+		{
+			if (*c != '%')
+				continue;
+
+			c++;
+			if (*c == '%')
+				continue;
+
+			while (contains("-+ #0", *c))
+				c++;
+			while (*c >= '0' && *c <= '9')
+				c++;
+			if (*c == '.')
+			{
+				c++;
+				while (*c >= '0' && *c <= '9')
+					c++;
+			}
+
+			if (*c == '\0' || !contains("diouxXc", *c))
+				return -1;
+
+			count++;
+		}
+
+		return count;
+	}
 
-  private:
-	static std::shared_ptr<Error> error;
+	static Error& Push(const char* message, uint32_t code);
+	static size_t FormatError(const Error& error, char* buffer, size_t size);
 
-	static size_t GetRequiredMessageSize(const std::shared_ptr<Error>& error, size_t depth = 0);
-	static std::shared_ptr<char[]> WriteInnerErrors(const std::shared_ptr<Error>& error);
+	template <typename... Args>
+	static void Record(const char* message, uint32_t code, Args... args)
+	{
+		static_assert(sizeof...(Args) <= MaxArguments, "Too many error message arguments");
+		static_assert(((std::is_integral_v<Args> || std::is_enum_v<Args>) && ...), "Error message arguments must be integers");
+
+		Error& error        = Push(message, code);
+		error.Arguments     = { static_cast<unsigned int>(args)... };
+		error.ArgumentCount = sizeof...(Args);
+	}
 
   public:
 	/**
@@ -59,19 +134,16 @@ class ErrorMessage
 
 	/**
 	 * @brief Get the current error message
+	 * @remark The message is formatted into a static buffer that is overwritten by the next call
 	 * @return const char* The current error message
 	 */
-	static const char* GetMessage()
-	{
-		if (error == nullptr)
-			return Error::EmptyError; // Return empty error message
-
-		std::shared_ptr<char[]> message = WriteInnerErrors(error);
-		if (message == nullptr)
-			return Error::EmptyError; // Return empty error message
-		
-		return message.get();
-	}
+	static const char* GetMessage();
+
+	/**
+	 * @brief Get the code of the innermost error, the root cause
+	 * @return uint32_t The error code, zero if there is no error or it has no code
+	 */
+	static uint32_t GetCode() { return depth > 0 ? errors[0].Code : 0; }
 
 	/**
 	 * @brief Print the current error messages to the serial port, will clear all messages after printing
@@ -79,31 +151,49 @@ class ErrorMessage
 	static void PrintMessage();
 
 	/// @brief Set the current error message
-	/// @param message A message to set the error. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
-	static void SetMessage(const char* message)
+	/// @param message A message to set the error, printed as is. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
+	static void SetMessage(const char* message) { SetError(0, message); }
+
+	/// @brief Set the current error message
+	/// @param message A printf format string checked against the arguments, see `FormatString`. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
+	/// @param args Integer arguments of the format string
+	template <typename... Args>
+	static void SetMessage(FormatString<std::type_identity_t<Args>...> message, Args... args)
 	{
-		error = std::shared_ptr<Error>(new Error(message));
+		SetError(0, message, args...);
 	}
-	
-	/// @brief Set the current error message
-	/// @param message A message to set the error.
-	static void SetMessage(const std::shared_ptr<char[]>& message)
+
+	/// @brief Set the current error message with an error code
+	/// @param code A numeric error code
+	/// @param message A message to set the error, printed as is. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
+	static void SetError(uint32_t code, const char* message)
 	{
-		error = std::shared_ptr<Error>(new Error(message));
+		ClearMessage();
+		Record(message, code);
 	}
 
-	/// @brief Wrap the current error message with a new message
-	/// @param message A message to wrap the inner error with. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
-	static void WrapMessage(const char* message)
+	/// @brief Set the current error message with an error code
+	/// @param code A numeric error code
+	/// @param message A printf format string checked against the arguments, see `FormatString`. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
+	/// @param args Integer arguments of the format string
+	template <typename... Args>
+	static void SetError(uint32_t code, FormatString<std::type_identity_t<Args>...> message, Args... args)
 	{
-		error = std::shared_ptr<Error>(new Error(message, error));
+		ClearMessage();
+		Record(message.Value, code, args...);
 	}
 
 	/// @brief Wrap the current error message with a new message
-	/// @param message A message to wrap the inner error with.
-	static void WrapMessage(const std::shared_ptr<char[]>& message)
+	/// @param message A message to wrap the inner error with, printed as is. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
+	static void WrapMessage(const char* message) { Record(message, 0); }
+
+	/// @brief Wrap the current error message with a new message
+	/// @param message A printf format string checked against the arguments, see `FormatString`. @remark DO NOT POINT TO A STACK ALLOCATED BUFFER.
+	/// @param args Integer arguments of the format string
+	template <typename... Args>
+	static void WrapMessage(FormatString<std::type_identity_t<Args>...> message, Args... args)
 	{
-		error = std::shared_ptr<Error>(new Error(message, error));
+		Record(message.Value, 0, args...);
 	}
 };
 
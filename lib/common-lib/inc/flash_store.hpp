@@ -0,0 +1,88 @@
+/**
+ * @file flash_store.hpp
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Small settings record kept in a reserved flash sector
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <type_traits>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Stores a versioned record in the `SETTINGS` flash sector reserved by the linker script
+ * @remark Each store appends a new copy of the record after the last one, and the sector is only erased once it is
+ * full, so a store rarely costs more than programming a few flash words. Loading returns the last copy whose header
+ * and checksum are valid, so a store interrupted by a reset leaves the previous copy in place. Erasing the sector
+ * stalls the CPU for up to a couple of seconds, store outside of the render loop.
+ */
+class FlashStore
+{
+  public:
+	/// @brief Header of each copy of the record, followed by the record padded to whole flash words
+	struct Header
+	{
+		uint32_t Magic;    ///< @brief Always `Magic`, erased flash reads as all ones
+		uint16_t Key;      ///< @brief Identifies the layout of the record, copies with another key are ignored
+		uint16_t Size;     ///< @brief Size of the record in bytes
+		uint32_t Checksum; ///< @brief Checksum of the header fields above and the record
+		uint32_t Reserved; ///< @brief Pads the header to 16 bytes
+	};
+
+	static constexpr uint32_t Magic       = 0x4C564653; ///< @brief "SFVL"
+	static constexpr size_t MaxRecordSize = 256;
+
+  private:
+	static uint32_t Checksum(const Header& header, std::span<const uint8_t> record);
+	static bool IsErased(uintptr_t address, size_t size);
+
+	static bool TryLoadBytes(uint16_t key, std::span<uint8_t> record);
+	static bool TryStoreBytes(uint16_t key, std::span<const uint8_t> record);
+
+  public:
+	FlashStore() = delete;
+
+	/**
+	 * @brief Load the last stored copy of a record
+	 *
+	 * @tparam T The record type, trivially copyable
+	 * @param key The layout key the record was stored with
+	 * @param record The record to load into, unchanged if no valid copy is found
+	 * @return `bool` Whether a valid copy was found
+	 */
+	template <typename T>
+	static bool TryLoad(uint16_t key, T& record)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Flash records must be trivially copyable");
+		static_assert(sizeof(T) <= MaxRecordSize, "Flash record is too large");
+
+		return TryLoadBytes(key, std::span(reinterpret_cast<uint8_t*>(&record), sizeof(T)));
+	}
+
+	/**
+	 * @brief Store a new copy of a record, erasing the sector first if it is full
+	 *
+	 * @tparam T The record type, trivially copyable
+	 * @param key The layout key of the record, change it when the layout of the record changes
+	 * @param record The record to store
+	 * @return `bool` Whether the record was stored and verified
+	 */
+	template <typename T>
+	static bool TryStore(uint16_t key, const T& record)
+	{
+		static_assert(std::is_trivially_copyable_v<T>, "Flash records must be trivially copyable");
+		static_assert(sizeof(T) <= MaxRecordSize, "Flash record is too large");
+
+		return TryStoreBytes(key, std::span(reinterpret_cast<const uint8_t*>(&record), sizeof(T)));
+	}
+};
+
+} // namespace LumiVoxel
@@ -1,5 +1,9 @@
 #pragma once
 
+#include "critical_section.h"
+#include "interrupt_queue.hpp"
+#include "timer_wheel.hpp"
+
 #include "stm32_includer.h"
 #include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_def.h)
@@ -20,26 +24,19 @@ class HighPrecisionCounter
 	const uint32_t timerPrecision;
 	uint64_t upperCount;
 
-	struct DelayedCallback
-	{
-		uint64_t DelayUntil;
-		std::function<void()> Callback;
+	/// @brief The length of the timer period in progress, shortened to interrupt when the next timer expires
+	uint32_t currentPeriod;
 
-		DelayedCallback()
-			: DelayUntil(0), Callback(nullptr)
-		{}
-	};
+	/// @brief Minimum time in microseconds between programming the period and the update interrupt
+	static constexpr uint32_t MinimumLead = 20;
 
-	static constexpr size_t MaxCallbacks = 32;
-	std::array<DelayedCallback, MaxCallbacks> delayedCallbacks;
-	
-	/// @brief The highest index of a delayed callback
-	size_t highestCallbackIndex = 0;
+	TimerWheel timers;
 
 	bool isInitialized = false;
 
 	void HandleDelayCallbacks();
 	void ClearCallbacks();
+	void ScheduleUpdate() __attribute__((section(".RamFunc")));
 
   public:
 	static constexpr uint32_t MillesecondsToMicroseconds = 1000;
@@ -51,7 +48,7 @@ class HighPrecisionCounter
 	 * @param timerPrecision The number of microseconds before the counter rolls over
 	 */
 	HighPrecisionCounter(TIM_TypeDef* const tim, uint32_t timerPrecision)
-		: tim(tim), timerPrecision(timerPrecision), upperCount(0), delayedCallbacks()
+		: tim(tim), timerPrecision(timerPrecision), upperCount(0), currentPeriod(timerPrecision), timers()
 	{}
 
 	/**
@@ -65,7 +62,7 @@ class HighPrecisionCounter
 	 * @brief Update the counter
 	 * @param statusRegister The timer status register when the interrupt was triggered
 	 * @param suppressCallbacks Whether to suppress the delayed callbacks
-	 * @remark This function should be called in the timer interrupt
+	 * @remark This function should be called in the timer interrupt, after clearing the update flag
 	 */
 	void Update(uint32_t statusRegister, bool suppressCallbacks = false) __attribute__((section(".RamFunc")));
 
@@ -73,10 +70,22 @@ class HighPrecisionCounter
 	 * @brief Get the current count of the timer
 	 *
 	 * @return `uint64_t` The current count in microseconds
+	 * @remark The period in progress may be shortened, so a wrap the interrupt has not handled yet adds that period
 	 */
 	uint64_t GetCount() const
 	{
-		return this->upperCount + this->tim->CNT;
+		// The interrupt must not update the upper count between reading it and the status register
+		uint32_t primask = EnterCriticalSection();
+
+		uint64_t count = this->upperCount + this->tim->CNT;
+
+		// The counter wrapped but the interrupt has not been handled yet, read it again after the wrap
+		if ((this->tim->SR & TIM_SR_UIF) != 0)
+			count = this->upperCount + this->currentPeriod + this->tim->CNT;
+
+		ExitCriticalSection(primask);
+
+		return count;
 	}
 
 	uint64_t GetUpperCount() const
@@ -110,6 +119,9 @@ class HighPrecisionCounter
 		ClearCallbacks();
 	}
 
+	/// @brief Handle used to cancel a timer
+	using TimerHandle = TimerWheel::Handle;
+
 	/**
 	 * @brief Delay for a number of microseconds
 	 *
@@ -135,9 +147,48 @@ class HighPrecisionCounter
 	 *
 	 * @param delay The delay in ms
 	 * @param callback The callback to execute
+	 * @param priority The priority the callback is queued with when it is due
+	 * @param budget The expected run time of the callback in microseconds, zero if unknown
 	 * @return `bool` Whether the callback was added
 	 */
-	bool AddDelayedCallback(uint32_t delay, const std::function<void()>& callback);
+	bool AddDelayedCallback(
+		uint32_t delay,
+		const std::function<void()>& callback,
+		InterruptQueue::Priority priority = InterruptQueue::Priority::Normal,
+		uint32_t budget                   = 0)
+	{
+		if (delay == 0)
+			return false;
+
+		return AddTimer(delay * MillesecondsToMicroseconds, callback, 0, priority, budget).IsValid();
+	}
+
+	/**
+	 * @brief Add a one-shot or periodic timer
+	 *
+	 * @remark The callback will be called in a non-interrupt context, after all other interrupts have been handled
+	 *
+	 * @param delay The delay in microseconds before the first call
+	 * @param callback The callback to execute
+	 * @param period The period in microseconds at which to repeat the callback, zero for a one-shot timer
+	 * @param priority The priority the callback is queued with when it is due
+	 * @param budget The expected run time of the callback in microseconds, zero if unknown
+	 * @return `TimerHandle` The handle of the timer, invalid if the timer could not be added
+	 */
+	TimerHandle AddTimer(
+		uint64_t delay,
+		const std::function<void()>& callback,
+		uint32_t period                   = 0,
+		InterruptQueue::Priority priority = InterruptQueue::Priority::Normal,
+		uint32_t budget                   = 0);
+
+	/**
+	 * @brief Cancel a timer
+	 *
+	 * @param handle The handle of the timer, invalidated on return
+	 * @return `bool` Whether the timer was still pending
+	 */
+	bool CancelTimer(TimerHandle& handle);
 };
 
 } // namespace LumiVoxel
@@ -0,0 +1,135 @@
+/**
+ * @file inplace_function.hpp
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Fixed capacity callable wrapper that never allocates
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace LumiVoxel
+{
+
+template <typename Signature, size_t Capacity>
+class InplaceFunction;
+
+/**
+ * @brief Move-only callable wrapper with inline storage, usable from interrupt context
+ *
+ * @tparam R The return type
+ * @tparam Args The argument types
+ * @tparam Capacity The number of bytes available for the stored callable
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InplaceFunction<R(Args...), Capacity>
+{
+  private:
+	/// @brief Type erased operations on the stored callable
+	struct Operations
+	{
+		R (*Invoke)(void* callable, Args&&... args);
+		void (*Move)(void* destination, void* source);
+		void (*Destroy)(void* callable);
+	};
+
+	template <typename F>
+	static constexpr Operations OperationsFor = {
+		[](void* callable, Args&&... args) -> R { return (*static_cast<F*>(callable))(std::forward<Args>(args)...); },
+		[](void* destination, void* source) { new (destination) F(std::move(*static_cast<F*>(source))); },
+		[](void* callable) { static_cast<F*>(callable)->~F(); },
+	};
+
+	alignas(std::max_align_t) std::byte storage[Capacity];
+	const Operations* operations = nullptr;
+
+  public:
+	constexpr InplaceFunction() = default;
+
+	constexpr InplaceFunction(std::nullptr_t) {}
+
+	/**
+	 * @brief Construct from a callable, which is moved or copied into the inline storage
+	 *
+	 * @tparam F The callable type
+	 * @param callable The callable to store
+	 */
+	template <typename F, typename D = std::decay_t<F>>
+		requires(!std::is_same_v<D, InplaceFunction> && std::is_invocable_r_v<R, D&, Args...>)
+	InplaceFunction(F&& callable)
+	{
+		static_assert(sizeof(D) <= Capacity, "Callable is too large for the inline storage");
+		static_assert(alignof(D) <= alignof(std::max_align_t), "Callable alignment is too strict for the inline storage");
+		static_assert(std::is_nothrow_move_constructible_v<D>, "Callable must be nothrow move constructible");
+
+		new (storage) D(std::forward<F>(callable));
+		operations = &OperationsFor<D>;
+	}
+
+	InplaceFunction(InplaceFunction&& other) noexcept
+	{
+		if (other.operations != nullptr)
+		{
+			other.operations->Move(storage, other.storage);
+			operations = other.operations;
+			other.Reset();
+		}
+	}
+
+	InplaceFunction& operator=(InplaceFunction&& other) noexcept
+	{
+		if (this != &other)
+		{
+			Reset();
+			if (other.operations != nullptr)
+			{
+				other.operations->Move(storage, other.storage);
+				operations = other.operations;
+				other.Reset();
+			}
+		}
+
+		return *this;
+	}
+
+	InplaceFunction& operator=(std::nullptr_t)
+	{
+		Reset();
+		return *this;
+	}
+
+	InplaceFunction(const InplaceFunction&)            = delete;
+	InplaceFunction& operator=(const InplaceFunction&) = delete;
+
+	~InplaceFunction() { Reset(); }
+
+	/**
+	 * @brief Destroy the stored callable, leaving the wrapper empty
+	 */
+	void Reset()
+	{
+		if (operations != nullptr)
+		{
+			operations->Destroy(storage);
+			operations = nullptr;
+		}
+	}
+
+	/**
+	 * @brief Call the stored callable
+	 * @remark The wrapper must not be empty
+	 */
+	R operator()(Args... args) { return operations->Invoke(storage, std::forward<Args>(args)...); }
+
+	explicit operator bool() const { return operations != nullptr; }
+
+	bool operator==(std::nullptr_t) const { return operations == nullptr; }
+};
+
+} // namespace LumiVoxel
@@ -1,25 +1,164 @@
 #pragma once
 
+#include "inplace_function.hpp"
+
 #include "stm32_includer.h"
 #include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_def.h)
 
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <functional>
+#include <limits>
+#include <utility>
 
 namespace LumiVoxel
 {
 
+class HighPrecisionCounter;
+
+/**
+ * @brief Lock-free multi-producer, single-consumer queues of deferred work, one per priority level
+ * @remark Interrupts reserve a slot with an atomic compare-and-swap (LDREX/STREX), construct the callback in place
+ * and publish it. `HandleQueue` runs the published callbacks from the main loop, highest priority first.
+ */
 class InterruptQueue
 {
+  public:
+	/// @brief Inline storage of a callback, large enough to hold a `std::function` or a lambda capturing a few pointers
+	static constexpr size_t CallbackSize = std::max(sizeof(std::function<void()>), 4 * sizeof(void*));
+
+	using Callback = InplaceFunction<void(), CallbackSize>;
+
+	/// @brief Priority levels of deferred work
+	enum struct Priority : uint8_t
+	{
+		High,   ///< @brief Latency critical work, always run regardless of the deadline
+		Normal, ///< @brief Regular work, run while it fits before the deadline
+		Low,    ///< @brief Background work, run once higher priorities are empty and it fits before the deadline
+		Count,
+	};
+
+	static constexpr size_t PriorityCount = static_cast<size_t>(Priority::Count);
+
+	/// @brief Deadline value that never expires
+	static constexpr uint64_t NoDeadline = std::numeric_limits<uint64_t>::max();
+
+  private:
 	static constexpr size_t MaxDepth = 32;
-	static std::array<std::function<void()>, MaxDepth> Queue;
-	static volatile size_t InterruptsPending;
+	static_assert((MaxDepth & (MaxDepth - 1)) == 0, "MaxDepth must be a power of two");
+
+	struct Slot
+	{
+		Callback Function;
+		uint32_t Budget = 0; ///< @brief Expected run time in microseconds, zero if unknown
+		std::atomic<bool> Ready = false;
+	};
+
+	struct Ring
+	{
+		std::array<Slot, MaxDepth> Slots;
+
+		/// @brief Free running index of the next slot to reserve
+		std::atomic<uint32_t> WriteIndex = 0;
+		/// @brief Free running index of the next slot to run
+		std::atomic<uint32_t> ReadIndex = 0;
+
+		/// @brief Number of callbacks rejected because the queue was full
+		std::atomic<uint32_t> DropCount = 0;
+		/// @brief Highest number of callbacks waiting at once
+		std::atomic<uint32_t> HighWater = 0;
+	};
+
+	static std::array<Ring, PriorityCount> Rings;
+
+	/// @brief Number of callbacks that ran longer than their budget
+	static std::atomic<uint32_t> OverrunCount;
+
+	/// @brief The counter used to check deadlines and budgets, `nullptr` disables them
+	static const HighPrecisionCounter* TimeSource;
+
+	static Slot* Reserve(Priority priority) __attribute__((section(".RamFunc")));
+
+	static void Publish(Slot* slot) __attribute__((section(".RamFunc")));
+
+	static Ring& GetRing(Priority priority) { return Rings[std::min(static_cast<size_t>(priority), PriorityCount - 1)]; }
 
   public:
-	static bool AddInterrupt(const std::function<void()>& callback) __attribute__((section(".RamFunc")));
+	/**
+	 * @brief Set the counter used to check deadlines and budgets
+	 *
+	 * @param counter The microsecond counter, `nullptr` to run all work without checking time
+	 */
+	static void SetTimeSource(const HighPrecisionCounter* counter) { TimeSource = counter; }
+
+	/**
+	 * @brief Add a callback to be run from the main loop
+	 * @remark The callable is only moved from when it is queued, so a rejected callable can be retried
+	 *
+	 * @param callback The callable to queue
+	 * @param priority The priority of the work
+	 * @param budget The expected run time in microseconds, zero if unknown
+	 * @return `bool` Whether the callback was queued, false if the queue is full
+	 */
+	template <typename F>
+	static bool AddInterrupt(F&& callback, Priority priority = Priority::Normal, uint32_t budget = 0)
+	{
+		Slot* slot = Reserve(priority);
+		if (slot == nullptr)
+			return false;
+
+		slot->Function = Callback(std::forward<F>(callback));
+		slot->Budget   = budget;
+		Publish(slot);
+
+		return true;
+	}
+
+	/**
+	 * @brief Run the queued callbacks, highest priority first
+	 * @remark Must be called from a non-interrupt context. High priority work always runs, lower priority work is left
+	 * queued once its budget no longer fits before the deadline so control returns to the render loop in time.
+	 *
+	 * @param deadline The counter value in microseconds by which to return, `NoDeadline` to run everything queued
+	 */
+	static void HandleQueue(uint64_t deadline = NoDeadline) __attribute__((section(".RamFunc")));
+
+	/**
+	 * @brief Get the number of callbacks waiting to be run
+	 *
+	 * @param priority The priority level
+	 * @return `size_t` The number of pending callbacks
+	 */
+	static size_t GetPending(Priority priority)
+	{
+		const Ring& ring = GetRing(priority);
+		return ring.WriteIndex.load(std::memory_order_relaxed) - ring.ReadIndex.load(std::memory_order_relaxed);
+	}
+
+	/**
+	 * @brief Get the number of callbacks rejected because the queue was full
+	 *
+	 * @param priority The priority level
+	 * @return `uint32_t` The drop count
+	 */
+	static uint32_t GetDropCount(Priority priority) { return GetRing(priority).DropCount.load(std::memory_order_relaxed); }
+
+	/**
+	 * @brief Get the highest number of callbacks that were waiting at once
+	 *
+	 * @param priority The priority level
+	 * @return `uint32_t` The high-water mark
+	 */
+	static uint32_t GetHighWater(Priority priority) { return GetRing(priority).HighWater.load(std::memory_order_relaxed); }
 
-	static void HandleQueue() __attribute__((section(".RamFunc")));
+	/**
+	 * @brief Get the number of callbacks that ran longer than their budget
+	 *
+	 * @return `uint32_t` The overrun count
+	 */
+	static uint32_t GetOverrunCount() { return OverrunCount.load(std::memory_order_relaxed); }
 };
 
 } // namespace LumiVoxel
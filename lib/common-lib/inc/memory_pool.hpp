@@ -0,0 +1,129 @@
+/**
+ * @file memory_pool.hpp
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Fixed capacity typed pool allocators for statically placed memory
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include "critical_section.h"
+#include "memory_regions.h"
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Fixed capacity pool of objects of one type
+ * @remark The pool holds its own storage, so it lives in whichever region the pool is placed in, for example
+ * `MemoryPool<Frame, 2> framePool DMA_BUFFER_D2;`. The zero filled state is an empty pool, so pools work in the zero
+ * filled DMA sections and before static constructors have run. Allocation and freeing are O(1) and safe to call from
+ * interrupts.
+ *
+ * @tparam T The type of the objects
+ * @tparam Capacity The number of objects
+ * @tparam Alignment The alignment of each object, each object is also padded to a multiple of it
+ */
+template <typename T, size_t Capacity, size_t Alignment = alignof(T)>
+class MemoryPool
+{
+	static_assert(Capacity > 0 && Capacity <= UINT16_MAX, "Pool capacity must fit in 16 bits");
+	static_assert(Alignment >= alignof(T) && (Alignment & (Alignment - 1)) == 0, "Alignment must be a power of two of at least the alignment of T");
+
+	struct alignas(Alignment) Block
+	{
+		std::byte Storage[sizeof(T)];
+	};
+
+	std::array<Block, Capacity> blocks;
+	std::array<uint16_t, Capacity> freeList;
+	uint16_t freeCount = 0; ///< @brief Number of freed blocks on `freeList`
+	uint16_t unused    = 0; ///< @brief Index of the first block that has never been allocated
+
+  public:
+	/// @brief Size of each object including padding
+	static constexpr size_t BlockSize = sizeof(Block);
+
+	/**
+	 * @brief Construct an object in the pool
+	 *
+	 * @param args The arguments of the constructor of `T`
+	 * @return `T*` The object, `nullptr` if the pool is exhausted
+	 */
+	template <typename... Args>
+	T* Allocate(Args&&... args)
+	{
+		uint32_t primask = EnterCriticalSection();
+
+		int32_t index = -1;
+		if (freeCount > 0)
+			index = freeList[--freeCount];
+		else if (unused < Capacity)
+			index = unused++;
+
+		ExitCriticalSection(primask);
+
+		if (index < 0)
+			return nullptr;
+
+		return new (blocks[index].Storage) T(std::forward<Args>(args)...);
+	}
+
+	/**
+	 * @brief Destroy an object and return it to the pool
+	 *
+	 * @param object An object allocated from this pool, may be `nullptr`
+	 */
+	void Free(T* object)
+	{
+		if (object == nullptr)
+			return;
+
+		object->~T();
+
+		uint16_t index = static_cast<uint16_t>(reinterpret_cast<Block*>(object) - blocks.data());
+
+		uint32_t primask      = EnterCriticalSection();
+		freeList[freeCount++] = index;
+		ExitCriticalSection(primask);
+	}
+
+	/**
+	 * @brief Check if an object is stored in this pool
+	 */
+	bool Owns(const T* object) const
+	{
+		auto address = reinterpret_cast<const std::byte*>(object);
+		auto start   = reinterpret_cast<const std::byte*>(blocks.data());
+
+		return address >= start && address < start + sizeof(blocks) && (address - start) % BlockSize == 0;
+	}
+
+	/**
+	 * @brief Get the number of objects that can still be allocated
+	 */
+	size_t GetAvailable() const { return freeCount + Capacity - unused; }
+
+	/**
+	 * @brief Get the total number of objects in the pool
+	 */
+	static constexpr size_t GetCapacity() { return Capacity; }
+};
+
+/**
+ * @brief Pool of DMA buffers, each aligned and padded to whole cache lines so cache maintenance of one buffer never
+ * touches another
+ * @remark Place it in a DMA section, `DMA_BUFFER_D2` or `DMA_BUFFER_D3` when the buffers should not be cached
+ */
+template <typename T, size_t Capacity>
+using DmaPool = MemoryPool<T, Capacity, CACHE_LINE_SIZE>;
+
+} // namespace LumiVoxel
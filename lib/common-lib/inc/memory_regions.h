@@ -0,0 +1,81 @@
+/**
+ * @file memory_regions.h
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Placement of variables and functions in the memory regions of the STM32H7
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include "stm32_includer.h"
+#include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
+#include STM32_INCLUDE(STM32_PROCESSOR, hal_def.h)
+
+/*
+ * Memory regions of the STM32H7 and what can reach them:
+ *
+ * | Region | Section       | CPU        | MDMA | DMA1/2 | BDMA | Cached |
+ * |--------|---------------|------------|------|--------|------|--------|
+ * | ITCM   | `.itcmram`    | Zero wait  | Yes  | No     | No   | No     |
+ * | DTCM   | `.dtcmram`    | Zero wait  | Yes  | No     | No   | No     |
+ * | RAM_D1 | `.dma_buffer` | AXI        | Yes  | Yes    | No   | Yes    |
+ * | RAM_D2 | `.ram_d2`     | AHB        | Yes  | Yes    | No   | No     |
+ * | RAM_D3 | `.ram_d3`     | AHB        | Yes  | Yes    | Yes  | No     |
+ *
+ * RAM_D2 and RAM_D3 are made non-cacheable by `MemoryRegionsConfigureMpu`, so buffers there need no cache maintenance.
+ * Buffers in `.dma_buffer` are cached and must be cleaned before the DMA reads them and invalidated after it writes them.
+ * The DMA sections are zero filled at startup, initializers of variables placed in them are ignored.
+ */
+
+/// @brief Size of a cache line, DMA buffers are aligned and padded to it so cache maintenance never touches neighbours
+#define CACHE_LINE_SIZE 32U
+
+/// @brief Round a buffer size up to whole cache lines
+#define CACHE_LINE_PAD(size) ((((size) + CACHE_LINE_SIZE - 1U) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE)
+
+/// @brief Place a function in ITCM, copied from flash at startup
+#define ITCM_CODE __attribute__((section(".itcmram")))
+
+/// @brief Whether the hot functions listed in the linker script are placed in ITCM, set by the CMake build. The
+/// STM32CubeIDE build links the script as is, so they are in ITCM unless the build says otherwise.
+#ifndef ITCM_HOT_CODE
+#define ITCM_HOT_CODE 1
+#endif
+
+/// @brief Place data used by the CPU only in DTCM, the DMA controllers other than MDMA cannot reach it
+#define DTCM_DATA __attribute__((section(".dtcmram")))
+
+/// @brief Place a cached DMA buffer in AXI SRAM, reachable by MDMA and DMA1/2
+#define DMA_BUFFER __attribute__((section(".dma_buffer"), aligned(CACHE_LINE_SIZE)))
+
+/// @brief Place a non-cacheable DMA buffer in D2 SRAM, reachable by MDMA and DMA1/2
+#define DMA_BUFFER_D2 __attribute__((section(".ram_d2"), aligned(CACHE_LINE_SIZE)))
+
+/// @brief Place a non-cacheable DMA buffer in D3 SRAM, the only region reachable by BDMA
+#define DMA_BUFFER_D3 __attribute__((section(".ram_d3"), aligned(CACHE_LINE_SIZE)))
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+/**
+ * @brief Configure the MPU to make D2 and D3 SRAM non-cacheable
+ * @remark Call before the data cache is enabled
+ */
+void MemoryRegionsConfigureMpu(void);
+
+/**
+ * @brief Check if the DMA controllers other than MDMA can reach a buffer
+ *
+ * @param address The start of the buffer
+ * @param size The size of the buffer in bytes
+ * @return `int` Non-zero if the whole buffer is in AXI, D2 or D3 SRAM
+ */
+int MemoryRegionsIsDmaReachable(const void* address, uint32_t size);
+
+#ifdef __cplusplus
+}
+#endif
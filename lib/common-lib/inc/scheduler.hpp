@@ -27,28 +27,49 @@ namespace LumiVoxel
 
 /**
  * @brief Scheduler class
+ * @remark Tickless: the due tasks are kept in a min-heap and the timer period is reprogrammed to end at the earliest
+ * deadline, so the timer only interrupts when a task is due. Deadlines are kept in timer counts, `precision` counts per
+ * tick, so intervals given in seconds are not rounded to whole ticks.
  */
 class Scheduler
 {
   private:
 	static constexpr size_t MaxTasks = 32;
 
+	/// @brief Longest timer period in counts, the limit of a 16 bit auto-reload register
+	static constexpr uint32_t MaxPeriod = 0x10000;
+	/// @brief Minimum number of counts between programming the period and the update interrupt
+	static constexpr uint32_t MinimumLead = 2;
+
 	/// @brief The timer peripheral to use for the scheduler
 	TIM_TypeDef* const tim;
 	/// @brief The tasks to run
 	/// @remark `nullptr` indicates an empty slot
 	std::array<std::function<void()>, MaxTasks> tasks = { nullptr };
-	/// @brief The intervals at which to run the tasks
+	/// @brief The intervals at which to run the tasks in timer counts
 	std::array<uint32_t, MaxTasks> intervals = { 0 };
-	/// @brief The offset from zero at which the tasks will run
+	/// @brief The offset from zero at which the tasks will run in timer counts
 	std::array<uint32_t, MaxTasks> startOffsets = { 0 };
-	/// @brief The counter value when the tasks will run next
-	std::array<uint32_t, MaxTasks> nextUpdates = { 0 };
+	/// @brief The timer count when the tasks will run next
+	std::array<uint64_t, MaxTasks> nextUpdates = { 0 };
+	/// @brief The priorities the tasks are queued with
+	std::array<InterruptQueue::Priority, MaxTasks> priorities = {};
+	/// @brief The expected run times of the tasks in microseconds, zero if unknown
+	std::array<uint32_t, MaxTasks> budgets = { 0 };
+	/// @brief Bumped whenever a slot is removed or reused, so queued runs of the previous task are skipped
+	std::array<uint32_t, MaxTasks> generations = { 0 };
 	/// @brief The enabled tasks
 	std::bitset<MaxTasks> enabledTasks;
 
-	/// @brief The internal counter used to track the scheduler
-	uint32_t counter = 0;
+	/// @brief Min-heap of the enabled task indices, ordered by `nextUpdates`
+	std::array<uint8_t, MaxTasks> heap = { 0 };
+	/// @brief The number of tasks in the heap
+	size_t heapSize = 0;
+
+	/// @brief The timer count at the start of the period in progress
+	uint64_t elapsed = 0;
+	/// @brief The length of the period in progress in timer counts
+	uint32_t currentPeriod = MaxPeriod;
 
 	/// @brief The tick frequency of the scheduler
 	const uint32_t frequency;
@@ -57,30 +78,48 @@ class Scheduler
 	/// @brief The number of ticks before the scheduler rolls over
 	const uint32_t timerRollOver;
 
-	/// @brief The highest index of a task in the scheduler
-	size_t highestTaskIndex = 0;
-
 	/// @brief Whether the scheduler is initialized
 	bool isInitialized = false;
 	/// @brief Whether the scheduler is paused
 	bool paused = false;
 
-	static constexpr uint32_t GetNextUpdate(uint32_t counter, uint32_t rollOver, uint32_t interval)
+	static constexpr uint64_t GetFirstUpdate(uint64_t now, uint32_t interval, uint32_t startOffset)
 	{
-		uint32_t nextUpdate = counter + interval;
-		if (nextUpdate >= rollOver)
-			nextUpdate -= rollOver;
+		if (startOffset > now)
+			return startOffset;
 
-		return nextUpdate;
+		if (interval == 0)
+			return now;
+
+		return now + interval - (now - startOffset) % interval;
 	}
 
-	static constexpr uint32_t GetFirstUpdate(uint32_t counter, uint32_t interval, uint32_t startOffset)
-	{
-		if (startOffset > counter)
-			return startOffset;
+	/**
+	 * @brief Get the current timer count, accounting for an update that is pending
+	 * @remark Must be called with interrupts disabled
+	 */
+	uint64_t GetNow() const;
 
-		return counter + interval - (counter - startOffset) % interval;
-	}
+	void HeapPush(uint8_t index);
+	void HeapRemove(size_t position);
+	void HeapSiftDown(size_t position);
+	void HeapSiftUp(size_t position);
+
+	/// @brief Add a task to the heap if it is enabled and not already in it
+	void Arm(size_t index);
+	/// @brief Remove a task from the heap if it is in it
+	void Disarm(size_t index);
+
+	/// @brief Reprogram the timer period to end at the earliest deadline
+	void ScheduleUpdate() __attribute__((section(".RamFunc")));
+
+	size_t AddTaskCounts(
+		const std::function<void()>& task,
+		uint32_t interval,
+		uint32_t startOffset,
+		bool enabled,
+		InterruptQueue::Priority priority,
+		uint32_t budget);
 
   public:
 	/**
@@ -125,7 +164,7 @@ class Scheduler
 	 *
 	 * @return `uint32_t` The current value of the internal counter
 	 */
-	uint32_t GetCounter() const { return counter; }
+	uint32_t GetCounter() const { return static_cast<uint32_t>((elapsed + tim->CNT) / timerPrecision % timerRollOver); }
 
 	/**
 	 * @brief Initialize the scheduler
@@ -137,7 +176,7 @@ class Scheduler
 
 	/**
 	 * @brief Update the scheduler, adding tasks to the interrupt queue when they are due
-	 * @remark This function should be called in the timer interrupt
+	 * @remark This function should be called in the timer interrupt, after clearing the update flag
 	 */
 	void Update() __attribute__((section(".RamFunc")));
 
@@ -148,22 +187,48 @@ class Scheduler
 	 * @param interval The interval in ticks at which to run the task. Zero indicates a one-shot task
 	 * @param startOffset The offset from zero at which the task will start to run
 	 * @param enabled Whether the task is enabled
+	 * @param priority The priority the task is queued with when it is due
+	 * @param budget The expected run time of the task in microseconds, zero if unknown
 	 * @return `size_t` The index of the task in the scheduler, returns `std::numeric_limits<size_t>::max()` if the task could not be added
 	 */
-	size_t AddTask(const std::function<void()>& task, uint32_t interval, uint32_t startOffset = 0, bool enabled = true);
+	size_t AddTask(
+		const std::function<void()>& task,
+		uint32_t interval,
+		uint32_t startOffset              = 0,
+		bool enabled                      = true,
+		InterruptQueue::Priority priority = InterruptQueue::Priority::Normal,
+		uint32_t budget                   = 0)
+	{
+		if (startOffset >= timerRollOver || interval >= timerRollOver)
+			return std::numeric_limits<size_t>::max();
+
+		return AddTaskCounts(task, interval * timerPrecision, startOffset * timerPrecision, enabled, priority, budget);
+	}
 
 	/**
 	 * @brief Add a task to the scheduler
 	 *
 	 * @param task The function to call when the task is due
-	 * @param interval The interval in seconds at which to run the task. Zero indicates a one-shot task
+	 * @param interval The interval in seconds at which to run the task, with sub-tick resolution. Zero indicates a one-shot task
 	 * @param startOffset The offset from zero in seconds at which the task will start to run
 	 * @param enabled Whether the task is enabled
+	 * @param priority The priority the task is queued with when it is due
+	 * @param budget The expected run time of the task in microseconds, zero if unknown
 	 * @return `size_t` The index of the task in the scheduler, returns `std::numeric_limits<size_t>::max()` if the task could not be added
 	 */
-	size_t AddTask(const std::function<void()>& task, float interval, float startOffset = 0, bool enabled = true)
+	size_t AddTask(
+		const std::function<void()>& task,
+		float interval,
+		float startOffset                 = 0,
+		bool enabled                      = true,
+		InterruptQueue::Priority priority = InterruptQueue::Priority::Normal,
+		uint32_t budget                   = 0)
 	{
-		return AddTask(task, static_cast<uint32_t>(interval * frequency), static_cast<uint32_t>(startOffset * frequency), enabled);
+		if (startOffset * frequency >= timerRollOver || interval * frequency >= timerRollOver)
+			return std::numeric_limits<size_t>::max();
+
+		float countFrequency = static_cast<float>(frequency) * timerPrecision;
+		return AddTaskCounts(task, static_cast<uint32_t>(interval * countFrequency), static_cast<uint32_t>(startOffset * countFrequency), enabled, priority, budget);
 	}
 
 	/**
@@ -179,26 +244,14 @@ class Scheduler
 	 * @remark Does nothing if the task is already enabled, or an empty slot
 	 * @param index The index of the task to enable
 	 */
-	void EnableTask(size_t index)
-	{
-		if (index >= MaxTasks)
-			return;
-
-		enabledTasks[index] = true;
-	}
+	void EnableTask(size_t index);
 
 	/**
 	 * @brief Disable a task
 	 * @remark Does nothing if the task is already disabled, or an empty slot
 	 * @param index The index of the task to disable
 	 */
-	void DisableTask(size_t index)
-	{
-		if (index >= MaxTasks)
-			return;
-
-		enabledTasks[index] = false;
-	}
+	void DisableTask(size_t index);
 
 	/**
 	 * @brief Get whether a task is enabled
@@ -225,7 +278,7 @@ class Scheduler
 		if (index >= MaxTasks)
 			return;
 
-		intervals[index] = interval;
+		intervals[index] = interval * timerPrecision;
 	}
 
 	/**
@@ -239,7 +292,7 @@ class Scheduler
 		if (index >= MaxTasks)
 			return 0;
 
-		return intervals[index];
+		return intervals[index] / timerPrecision;
 	}
 
 	/**
@@ -257,14 +310,24 @@ class Scheduler
 	/**
 	 * @brief Resume the scheduler
 	 */
-	void Resume() { paused = false; }
+	void Resume()
+	{
+		paused = false;
+		ScheduleUpdate();
+	}
 
 	/**
 	 * @brief Set the paused state of the scheduler
 	 *
 	 * @param paused Whether the scheduler should be paused
 	 */
-	void SetPaused(bool paused) { this->paused = paused; }
+	void SetPaused(bool paused)
+	{
+		if (paused)
+			Pause();
+		else
+			Resume();
+	}
 };
 
 } // namespace LumiVoxel
\ No newline at end of file
@@ -14,8 +14,33 @@
 #include <functional>
 #include <cstdio>
 
+/// @brief What a write does when the stdout buffer is full
+enum struct SyscallOverflowPolicy
+{
+	Drop,  ///< @brief Discard the part of the write that does not fit
+	Block, ///< @brief Wait for the DMA to make room, writes from interrupts or with interrupts masked still drop
+};
+
+/**
+ * @brief Retarget stdout and stderr to a UART
+ * @remark When the UART has a TX DMA stream linked and UART callback registration is enabled, writes are copied into a
+ * lock-free ring buffer drained by DMA in the background and the callbacks run from the transfer complete interrupt.
+ * Otherwise writes block until transmitted.
+ *
+ * @param huart The UART handle
+ * @param timeout The timeout of blocking transfers in milliseconds
+ * @param onTxStart Called before each transfer starts, may be empty
+ * @param onTxEnd Called after each transfer ends, may be empty
+ */
 void SyscallUARTRetarget(UART_HandleTypeDef* huart, uint32_t timeout, std::function<void()> onTxStart, std::function<void()> onTxEnd);
 
+/**
+ * @brief Set what a write does when the stdout buffer is full
+ *
+ * @param policy The overflow policy, `SyscallOverflowPolicy::Drop` by default
+ */
+void SyscallSetOverflowPolicy(SyscallOverflowPolicy policy);
+
 // Debug print
 #pragma GCC push_options
 #pragma GCC optimize("O3")
@@ -34,6 +59,17 @@ extern "C"
 
 int IsRetargeted();
 
+/**
+ * @brief Block until all buffered output has been transmitted
+ * @remark Safe to call from fault handlers and with interrupts masked
+ */
+void SyscallFlush(void);
+
+/**
+ * @brief Get the number of output bytes discarded because the stdout buffer was full
+ */
+uint32_t SyscallGetDroppedBytes(void);
+
 #ifdef __cplusplus
 }
 #endif
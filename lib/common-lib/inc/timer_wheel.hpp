@@ -0,0 +1,143 @@
+/**
+ * @file timer_wheel.hpp
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Hierarchical timer wheel with microsecond resolution
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include "interrupt_queue.hpp"
+
+#include <array>
+#include <cstdint>
+#include <functional>
+#include <limits>
+
+namespace LumiVoxel
+{
+
+/**
+ * @brief Hierarchical timer wheel of one-shot and periodic timers
+ * @remark Each level has 64 slots, level `k` slots span 64^k microseconds. A timer is filed in the level of the
+ * highest 6 bit group in which its expiry differs from the wheel time, so insertion and cancellation are O(1).
+ * Advancing jumps straight to the next occupied slot using the slot occupancy masks, and slots of higher levels are
+ * redistributed to lower levels when the wheel time reaches them. Timers beyond the top level wait in an overflow list
+ * until the wheel time reaches their top level block.
+ */
+class TimerWheel
+{
+  public:
+	/// @brief Handle used to cancel a timer
+	struct Handle
+	{
+		uint8_t Index       = InvalidIndex;
+		uint16_t Generation = 0;
+
+		bool IsValid() const { return Index != InvalidIndex; }
+	};
+
+	static constexpr size_t MaxTimers  = 32;
+	static constexpr uint64_t NoExpiry = std::numeric_limits<uint64_t>::max();
+
+  private:
+	static constexpr uint8_t InvalidIndex = 0xFF;
+	static constexpr size_t LevelBits     = 6;
+	static constexpr size_t SlotCount     = 1 << LevelBits;
+	static constexpr size_t LevelCount    = 4;
+	static constexpr size_t WheelBits     = LevelBits * LevelCount;
+
+	static constexpr uint8_t FreeLevel     = 0xFF;
+	static constexpr uint8_t OverflowLevel = LevelCount;
+
+	/// @brief Maximum number of slots visited per call to `Advance`, the rest is handled on the next call
+	static constexpr size_t MaxStepsPerAdvance = 16;
+	/// @brief Delay before retrying a one-shot timer that could not be queued
+	static constexpr uint32_t RetryDelay = 100;
+
+	struct Timer
+	{
+		uint64_t Expiry = 0;
+		uint32_t Period = 0; ///< @brief Period in microseconds, zero for a one-shot timer
+		std::function<void()> Callback;
+		InterruptQueue::Priority Priority = InterruptQueue::Priority::Normal;
+		uint32_t Budget                   = 0;
+		uint16_t Generation               = 0;
+		uint8_t Level                     = FreeLevel;
+		uint8_t Slot                      = 0;
+		uint8_t Next                      = InvalidIndex;
+		uint8_t Prev                      = InvalidIndex;
+	};
+
+	std::array<Timer, MaxTimers> timers;
+	std::array<std::array<uint8_t, SlotCount>, LevelCount> slots;
+	std::array<uint64_t, LevelCount> occupied = { 0 };
+	uint8_t overflow                          = InvalidIndex;
+	/// @brief Where to start searching for a free timer, so a just freed timer is not immediately reused
+	uint8_t nextAllocation = 0;
+
+	/// @brief The time up to which the wheel has been processed
+	uint64_t wheelTime = 0;
+
+	uint8_t& GetHead(uint8_t level, uint8_t slot) { return level == OverflowLevel ? overflow : slots[level][slot]; }
+
+	void Link(uint8_t index);
+	void Unlink(uint8_t index);
+	void Expire(uint8_t index, uint64_t now);
+
+  public:
+	TimerWheel() { Clear(); }
+
+	/**
+	 * @brief Remove all timers and restart the wheel at a time
+	 *
+	 * @param time The time to restart the wheel at in microseconds
+	 */
+	void Clear(uint64_t time = 0);
+
+	/**
+	 * @brief Add a timer
+	 * @remark Must not be called from an interrupt that can preempt `Advance`
+	 *
+	 * @param expiry The time at which the timer expires in microseconds
+	 * @param callback The callback to queue when the timer expires
+	 * @param period The period in microseconds at which to repeat the timer, zero for a one-shot timer
+	 * @param priority The priority the callback is queued with
+	 * @param budget The expected run time of the callback in microseconds, zero if unknown
+	 * @return `Handle` The handle of the timer, invalid if there are no free timers
+	 */
+	Handle Add(
+		uint64_t expiry,
+		const std::function<void()>& callback,
+		uint32_t period                   = 0,
+		InterruptQueue::Priority priority = InterruptQueue::Priority::Normal,
+		uint32_t budget                   = 0);
+
+	/**
+	 * @brief Cancel a timer
+	 * @remark A callback already queued for a periodic timer does not run after the timer is cancelled
+	 *
+	 * @param handle The handle of the timer, invalidated on return
+	 * @return `bool` Whether the timer was still pending
+	 */
+	bool Cancel(Handle& handle);
+
+	/**
+	 * @brief Queue the callbacks of all timers that expired up to a time
+	 * @remark Visits a bounded number of slots, check `GetNextExpiry` to know whether work remains
+	 *
+	 * @param now The current time in microseconds
+	 */
+	void Advance(uint64_t now) __attribute__((section(".RamFunc")));
+
+	/**
+	 * @brief Get the time of the next slot that needs processing
+	 *
+	 * @return `uint64_t` The time in microseconds, `NoExpiry` if there are no timers
+	 */
+	uint64_t GetNextExpiry() const __attribute__((section(".RamFunc")));
+};
+
+} // namespace LumiVoxel
@@ -0,0 +1,22 @@
+#include "binary_log.hpp"
+#include "high_precision_counter.hpp"
+
+#include <unistd.h>
+
+using namespace LumiVoxel;
+
+const HighPrecisionCounter* BinaryLog::TimeSource = nullptr;
+
+void BinaryLog::Emit(const char* format, uint8_t* record, size_t length)
+{
+	// The address of the format string is its offset in the unloaded `.logstr` section
+	uint16_t id        = static_cast<uint16_t>(reinterpret_cast<uintptr_t>(format));
+	uint32_t timestamp = TimeSource != nullptr ? static_cast<uint32_t>(TimeSource->GetCount()) : 0;
+
+	record[0] = FrameMarker;
+	record[1] = static_cast<uint8_t>(length - 2);
+	Store(&record[2], id);
+	Store(&record[4], timestamp);
+
+	write(STDOUT_FILENO, record, length);
+}
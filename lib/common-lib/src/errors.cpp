@@ -1,81 +1,101 @@
 #include "errors.hpp"
 
+#include <algorithm>
+#include <cstdio>
+
 using namespace LumiVoxel;
 
 using Error = ErrorMessage::Error;
 
-std::shared_ptr<Error> ErrorMessage::error = nullptr;
+std::array<Error, ErrorMessage::MaxDepth> ErrorMessage::errors;
+size_t ErrorMessage::depth        = 0;
+size_t ErrorMessage::droppedCount = 0;
+
+/// @brief Maximum length of a single formatted error record
+static constexpr size_t MaxErrorLength = 160;
+
+static std::array<char, ErrorMessage::MaxDepth * (MaxErrorLength + ErrorMessage::MaxDepth)> messageBuffer;
 
 void ErrorMessage::ClearMessage()
 {
-	if (error != nullptr)
-		error = nullptr;
+	depth        = 0;
+	droppedCount = 0;
 }
 
-size_t ErrorMessage::GetRequiredMessageSize(const std::shared_ptr<Error>& error, size_t depth)
+Error& ErrorMessage::Push(const char* message, uint32_t code)
 {
-	size_t size = depth + strlen(error->Message.get()) + 1; // +depth for tabs, +1 for newline
+	// Keep the root cause when the stack is full, the newest context replaces the outermost record
+	if (depth == MaxDepth)
+	{
+		depth--;
+		droppedCount++;
+	}
 
-	if (error->InnerError != nullptr)
-		size += GetRequiredMessageSize(error->InnerError, depth + 1);
+	Error& error  = errors[depth++];
+	error.Message = message != nullptr ? message : Error::EmptyError;
+	error.Code    = code;
 
-	return size + 1; // +1 for null terminator
+	return error;
 }
 
-static char* WriteInnerErrorsInternal(const std::shared_ptr<Error>& error, char* buffer, size_t depth = 0)
-{
-	size_t messageLen = strlen(error->Message.get());
-	for (size_t i = 0; i < depth; i++)
-		*(buffer++) = '\t';
-
-	memcpy(buffer, error->Message.get(), messageLen);
-	buffer += messageLen;
-	*(buffer++) = '\n';
-
-	if (error->InnerError != nullptr)
-		buffer = WriteInnerErrorsInternal(error->InnerError, buffer, depth + 1);
-	else
-		*(buffer++) = '\0';
+// The format strings are checked against their arguments by `FormatString` where each error is set
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wformat-nonliteral"
 
-	return buffer;
-}
-
-std::shared_ptr<char[]> ErrorMessage::WriteInnerErrors(const std::shared_ptr<Error>& error)
+size_t ErrorMessage::FormatError(const Error& error, char* buffer, size_t size)
 {
-	if (error == nullptr)
-		return nullptr;
+	const auto& args = error.Arguments;
 
-	size_t size = GetRequiredMessageSize(error);
-	std::shared_ptr<char[]> message(new char[size]);
+	// A message without arguments is printed as is, so a stray '%' is not read as a conversion
+	int length = error.ArgumentCount == 0
+	               ? snprintf(buffer, size, "%s", error.Message)
+	               : snprintf(buffer, size, error.Message, args[0], args[1], args[2], args[3], args[4], args[5]);
 
-	WriteInnerErrorsInternal(error, message.get());
+	if (length >= 0 && static_cast<size_t>(length) < size && error.Code != 0)
+		length += snprintf(buffer + length, size - length, " (code %lu)", static_cast<unsigned long>(error.Code));
 
-	return message;
+	return length < 0 ? 0 : std::min(static_cast<size_t>(length), size - 1);
 }
 
-static void PrintInternal(const std::shared_ptr<Error>& error, size_t depth = 0)
-{
-	constexpr const char* tabString = "\t\t\t\t\t\t\t\tMore inner errors...";
-	constexpr size_t tabChars       = 8;
-	constexpr size_t takeChars      = 1;
+#pragma GCC diagnostic pop
 
-	if (depth >= tabChars / takeChars)
+const char* ErrorMessage::GetMessage()
+{
+	size_t index = 0;
+	for (size_t i = 0; i < depth; i++)
 	{
-		puts(tabString);
-		return;
+		// Outermost error first, each inner error indented one more level
+		for (size_t tab = 0; tab < i && index < messageBuffer.size() - 1; tab++)
+			messageBuffer[index++] = '\t';
+
+		index += FormatError(errors[depth - 1 - i], &messageBuffer[index], messageBuffer.size() - index);
+
+		if (index < messageBuffer.size() - 1)
+			messageBuffer[index++] = '\n';
 	}
 
-	printf("%.*s%s\n", takeChars * depth, tabString, error->Message.get());
+	messageBuffer[index] = '\0';
 
-	if (error->InnerError != nullptr)
-		PrintInternal(error->InnerError, depth + 1);
+	return messageBuffer.data();
 }
 
 void ErrorMessage::PrintMessage()
 {
-	if (error == nullptr)
+	constexpr const char* tabString = "\t\t\t\t\t\t\t\t";
+	static_assert(MaxDepth <= 8, "Not enough tabs to indent every error");
+
+	if (depth == 0)
 		return;
 
-	PrintInternal(error);
+	char line[MaxErrorLength];
+	for (size_t i = 0; i < depth; i++)
+	{
+		FormatError(errors[depth - 1 - i], line, sizeof(line));
+		printf("%.*s%s\n", static_cast<int>(i), tabString, line);
+
+		if (i == 0 && droppedCount > 0)
+			printf("\t%u more errors omitted...\n", static_cast<unsigned int>(droppedCount));
+	}
+
 	ClearMessage();
-}
\ No newline at end of file
+}
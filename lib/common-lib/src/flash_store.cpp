@@ -0,0 +1,173 @@
+#include "flash_store.hpp"
+
+#include "errors.hpp"
+
+#include "stm32_includer.h"
+#include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
+#include STM32_INCLUDE(STM32_PROCESSOR, hal_flash.h)
+#include STM32_INCLUDE(STM32_PROCESSOR, hal_flash_ex.h)
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+
+using namespace LumiVoxel;
+
+// Sector bounds defined by the linker script
+extern "C" uint8_t _ssettings[], _esettings[];
+
+static constexpr size_t FlashWordSize = FLASH_NB_32BITWORD_IN_FLASHWORD * sizeof(uint32_t);
+
+/// @brief Size of a copy of a record, the header and record padded to whole flash words
+static constexpr size_t SlotSize(size_t size)
+{
+	return ((sizeof(FlashStore::Header) + size + FlashWordSize - 1) / FlashWordSize) * FlashWordSize;
+}
+
+/// @brief Get the address just past the last copy in the sector
+static uintptr_t FindEnd()
+{
+	uintptr_t address = reinterpret_cast<uintptr_t>(_ssettings);
+	uintptr_t end     = reinterpret_cast<uintptr_t>(_esettings);
+
+	while (address + sizeof(FlashStore::Header) <= end)
+	{
+		const FlashStore::Header* header = reinterpret_cast<const FlashStore::Header*>(address);
+		if (header->Magic != FlashStore::Magic || header->Size > FlashStore::MaxRecordSize)
+			break;
+
+		address += SlotSize(header->Size);
+	}
+
+	return std::min(address, end);
+}
+
+uint32_t FlashStore::Checksum(const Header& header, std::span<const uint8_t> record)
+{
+	// FNV-1a over the header fields before the checksum and the record
+	uint32_t hash = 2166136261u;
+	auto add      = [&hash](uint8_t byte) { hash = (hash ^ byte) * 16777619u; };
+
+	const uint8_t* fields = reinterpret_cast<const uint8_t*>(&header);
+	for (size_t i = 0; i < offsetof(Header, Checksum); i++)
+		add(fields[i]);
+
+	for (uint8_t byte : record)
+		add(byte);
+
+	return hash;
+}
+
+bool FlashStore::IsErased(uintptr_t address, size_t size)
+{
+	const uint32_t* words = reinterpret_cast<const uint32_t*>(address);
+	for (size_t i = 0; i < size / sizeof(uint32_t); i++)
+	{
+		if (words[i] != UINT32_MAX)
+			return false;
+	}
+
+	return true;
+}
+
+bool FlashStore::TryLoadBytes(uint16_t key, std::span<uint8_t> record)
+{
+	uintptr_t address = reinterpret_cast<uintptr_t>(_ssettings);
+	uintptr_t end     = FindEnd();
+
+	// Copies are appended in order, the last valid one is the newest
+	const uint8_t* found = nullptr;
+	while (address < end)
+	{
+		const Header* header = reinterpret_cast<const Header*>(address);
+		const uint8_t* data  = reinterpret_cast<const uint8_t*>(address + sizeof(Header));
+
+		if (header->Key == key && header->Size == record.size() && header->Checksum == Checksum(*header, std::span(data, header->Size)))
+			found = data;
+
+		address += SlotSize(header->Size);
+	}
+
+	if (found == nullptr)
+		return false;
+
+	memcpy(record.data(), found, record.size());
+	return true;
+}
+
+bool FlashStore::TryStoreBytes(uint16_t key, std::span<const uint8_t> record)
+{
+	uintptr_t start = reinterpret_cast<uintptr_t>(_ssettings);
+	uintptr_t end   = reinterpret_cast<uintptr_t>(_esettings);
+	size_t slot     = SlotSize(record.size());
+
+	uintptr_t address = FindEnd();
+	bool erase        = address + slot > end || !IsErased(address, slot);
+
+	alignas(uint32_t) std::array<uint8_t, SlotSize(MaxRecordSize)> buffer;
+	buffer.fill(0xFF);
+
+	Header header = {
+		.Magic    = Magic,
+		.Key      = key,
+		.Size     = static_cast<uint16_t>(record.size()),
+		.Checksum = 0,
+		.Reserved = UINT32_MAX,
+	};
+	header.Checksum = Checksum(header, record);
+
+	memcpy(buffer.data(), &header, sizeof(header));
+	memcpy(buffer.data() + sizeof(header), record.data(), record.size());
+
+	HAL_FLASH_Unlock();
+
+	if (erase)
+	{
+		FLASH_EraseInitTypeDef eraseInit = {
+			.TypeErase    = FLASH_TYPEERASE_SECTORS,
+			.Banks        = FLASH_BANK_1,
+			.Sector       = static_cast<uint32_t>((start - FLASH_BANK1_BASE) / FLASH_SECTOR_SIZE),
+			.NbSectors    = 1,
+			.VoltageRange = FLASH_VOLTAGE_RANGE_3,
+		};
+
+		uint32_t sectorError     = 0;
+		HAL_StatusTypeDef status = HAL_FLASHEx_Erase(&eraseInit, &sectorError);
+		if (status != HAL_OK)
+		{
+			HAL_FLASH_Lock();
+			ErrorMessage::SetError(status, "Flash Store - Store failed: Sector erase failed");
+			return false;
+		}
+
+		address = start;
+	}
+
+	for (size_t offset = 0; offset < slot; offset += FlashWordSize)
+	{
+		HAL_StatusTypeDef status = HAL_FLASH_Program(FLASH_TYPEPROGRAM_FLASHWORD, address + offset, reinterpret_cast<uint32_t>(buffer.data() + offset));
+		if (status != HAL_OK)
+		{
+			HAL_FLASH_Lock();
+			ErrorMessage::SetError(status, "Flash Store - Store failed: Program failed at %08X", address + offset);
+			return false;
+		}
+	}
+
+	HAL_FLASH_Lock();
+
+	// Flash is cached, drop any stale lines of the erased or programmed words before verifying
+	if (erase)
+		SCB_InvalidateDCache_by_Addr(reinterpret_cast<void*>(start), static_cast<int32_t>(end - start));
+	else
+		SCB_InvalidateDCache_by_Addr(reinterpret_cast<void*>(address), static_cast<int32_t>(slot));
+
+	if (memcmp(reinterpret_cast<const void*>(address), buffer.data(), slot) != 0)
+	{
+		ErrorMessage::SetMessage("Flash Store - Store failed: Verification failed at %08X", address);
+		return false;
+	}
+
+	return true;
+}
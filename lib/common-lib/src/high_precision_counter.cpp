@@ -1,7 +1,10 @@
 #include "high_precision_counter.hpp"
+#include "critical_section.h"
 #include "interrupt_queue.hpp"
 #include "timer_helpers.h"
 
+#include <algorithm>
+
 using namespace LumiVoxel;
 
 void HighPrecisionCounter::Update(uint32_t statusRegister, bool suppressCallbacks)
@@ -10,10 +13,12 @@ void HighPrecisionCounter::Update(uint32_t statusRegister, bool suppressCallback
 		return;
 
 	if ((statusRegister & TIM_SR_UIF) != 0)
-		this->upperCount += this->timerPrecision;
+		this->upperCount += this->currentPeriod;
 
 	if (!suppressCallbacks)
 		this->HandleDelayCallbacks();
+
+	this->ScheduleUpdate();
 }
 
 bool HighPrecisionCounter::Init()
@@ -22,16 +27,18 @@ bool HighPrecisionCounter::Init()
 		return true;
 
 	upperCount         = 0;
+	currentPeriod      = timerPrecision;
 	uint32_t clockFreq = GetTimerInputFrequency(tim);
 
+	// ARR is not preloaded so the period in progress can be shortened when a timer is due before it ends
 	tim->CR1  = 0;
 	tim->DIER = TIM_DIER_UIE;
 	tim->PSC  = clockFreq / 1000000 - 1;
 	tim->ARR  = timerPrecision - 1;
 	tim->CNT  = 0xFFFFFFFF;
-	tim->CR1 |= TIM_CR1_CEN | TIM_CR1_ARPE;
+	tim->CR1 |= TIM_CR1_CEN;
 
-	delayedCallbacks.fill(DelayedCallback());
+	timers.Clear();
 
 	isInitialized = true;
 
@@ -40,57 +47,63 @@ bool HighPrecisionCounter::Init()
 
 void HighPrecisionCounter::HandleDelayCallbacks()
 {
-	uint64_t count = GetCount();
-	for (size_t i = 0; i < highestCallbackIndex; i++)
-	{
-		DelayedCallback& delayedCallback = delayedCallbacks[i];
-		if (delayedCallback.Callback != nullptr && delayedCallback.DelayUntil != 0 && count >= delayedCallback.DelayUntil)
-		{
-			// If the interrupt queue is full, try again next time
-			if (!InterruptQueue::AddInterrupt(delayedCallback.Callback))
-				continue;
+	timers.Advance(GetCount());
+}
 
-			delayedCallback.DelayUntil = 0;
-			delayedCallback.Callback   = nullptr;
+void HighPrecisionCounter::ScheduleUpdate()
+{
+	uint32_t primask = EnterCriticalSection();
 
-			if (i + 1 >= highestCallbackIndex)
-				highestCallbackIndex--;
+	// A pending update is handled by the interrupt, which schedules the next one itself
+	if ((tim->SR & TIM_SR_UIF) == 0)
+	{
+		uint32_t period     = timerPrecision;
+		uint64_t nextExpiry = timers.GetNextExpiry();
+
+		if (nextExpiry < upperCount + timerPrecision)
+		{
+			uint32_t earliest = std::min(tim->CNT + MinimumLead, timerPrecision);
+			uint32_t due      = nextExpiry > upperCount ? static_cast<uint32_t>(nextExpiry - upperCount) : 0;
+			period            = std::clamp(due, earliest, timerPrecision);
 		}
+
+		tim->ARR      = period - 1;
+		currentPeriod = period;
 	}
+
+	ExitCriticalSection(primask);
 }
 
 void HighPrecisionCounter::ClearCallbacks()
 {
-	for (size_t i = 0; i < delayedCallbacks.size(); i++)
-	{
-		delayedCallbacks[i].DelayUntil = 0;
-		delayedCallbacks[i].Callback   = nullptr;
-	}
+	uint32_t primask = EnterCriticalSection();
+	timers.Clear(GetCount());
+	ExitCriticalSection(primask);
 }
 
-bool HighPrecisionCounter::AddDelayedCallback(uint32_t delay, const std::function<void()>& callback)
+HighPrecisionCounter::TimerHandle HighPrecisionCounter::AddTimer(
+	uint64_t delay,
+	const std::function<void()>& callback,
+	uint32_t period,
+	InterruptQueue::Priority priority,
+	uint32_t budget)
 {
-	if (delay == 0 || callback == nullptr)
-		return false;
-
-	uint64_t delayUntil = GetCount() + delay * MillesecondsToMicroseconds;
+	uint32_t primask   = EnterCriticalSection();
+	TimerHandle handle = timers.Add(GetCount() + delay, callback, period, priority, budget);
+	ExitCriticalSection(primask);
 
-	for (size_t i = 0; i < delayedCallbacks.size(); i++)
-	{
-		// Search for an empty slot
-		DelayedCallback& delayedCallback = delayedCallbacks[i];
-		if (delayedCallback.Callback == nullptr || delayedCallback.DelayUntil == 0)
-		{
-			delayedCallback.DelayUntil = delayUntil;
-			delayedCallback.Callback   = callback;
+	// The new timer may be due before the period in progress ends
+	if (handle.IsValid())
+		ScheduleUpdate();
 
-			if (i >= highestCallbackIndex)
-				highestCallbackIndex = i + 1;
+	return handle;
+}
 
-			return true;
-		}
-	}
+bool HighPrecisionCounter::CancelTimer(TimerHandle& handle)
+{
+	uint32_t primask = EnterCriticalSection();
+	bool cancelled   = timers.Cancel(handle);
+	ExitCriticalSection(primask);
 
-	// No empty slots
-	return false;
-}
\ No newline at end of file
+	return cancelled;
+}
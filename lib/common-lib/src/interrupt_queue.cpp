@@ -1,51 +1,81 @@
 #include "interrupt_queue.hpp"
-
-#include "critical_section.h"
-
-#include <cstdio>
+#include "high_precision_counter.hpp"
 
 using namespace LumiVoxel;
 
-std::array<std::function<void()>, InterruptQueue::MaxDepth> InterruptQueue::Queue;
-volatile size_t InterruptQueue::InterruptsPending = 0;
+std::array<InterruptQueue::Ring, InterruptQueue::PriorityCount> InterruptQueue::Rings;
+std::atomic<uint32_t> InterruptQueue::OverrunCount     = 0;
+const HighPrecisionCounter* InterruptQueue::TimeSource = nullptr;
 
-bool InterruptQueue::AddInterrupt(const std::function<void()>& callback)
+InterruptQueue::Slot* InterruptQueue::Reserve(Priority priority)
 {
-	if (InterruptQueue::InterruptsPending >= InterruptQueue::MaxDepth)
-		return false;
+	Ring& ring = GetRing(priority);
 
-	// Disable interrupts while modifying the queue
-	uint32_t primask = EnterCriticalSection();
+	uint32_t write = ring.WriteIndex.load(std::memory_order_relaxed);
+	do
+	{
+		// A slot is only reused once the consumer has moved its callback out and advanced the read index
+		if (write - ring.ReadIndex.load(std::memory_order_acquire) >= MaxDepth)
+		{
+			ring.DropCount.fetch_add(1, std::memory_order_relaxed);
+			return nullptr;
+		}
+	} while (!ring.WriteIndex.compare_exchange_weak(write, write + 1, std::memory_order_acq_rel, std::memory_order_relaxed));
 
-	Queue[InterruptQueue::InterruptsPending] = callback;
-	InterruptQueue::InterruptsPending        = InterruptQueue::InterruptsPending + 1;
+	uint32_t depth     = write + 1 - ring.ReadIndex.load(std::memory_order_relaxed);
+	uint32_t highWater = ring.HighWater.load(std::memory_order_relaxed);
+	while (depth > highWater && !ring.HighWater.compare_exchange_weak(highWater, depth, std::memory_order_relaxed)) {
+	}
 
-	// Re-enable interrupts
-	ExitCriticalSection(primask);
+	return &ring.Slots[write % MaxDepth];
+}
 
-	return true;
+void InterruptQueue::Publish(Slot* slot)
+{
+	slot->Ready.store(true, std::memory_order_release);
 }
 
-void InterruptQueue::HandleQueue()
-{	
+void InterruptQueue::HandleQueue(uint64_t deadline)
+{
 	if ((SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0)
-		return;	// This should never be called from an interrupt, so if it is, return
+		return; // This should never be called from an interrupt, so if it is, return
 
-	if (InterruptsPending > 0)
+	// Bounded so that work which queues itself cannot starve the main loop
+	for (size_t i = 0; i < MaxDepth * PriorityCount; i++)
 	{
-		for (size_t i = 0; i < InterruptsPending; i++)
+		// Rescan from the highest priority after every callback, so urgent work queued meanwhile runs next
+		size_t level = 0;
+		Slot* slot   = nullptr;
+		uint32_t read;
+		for (; level < PriorityCount; level++)
 		{
-			const std::function<void()>& interrupt = InterruptQueue::Queue[i];
-			if (interrupt)
-			{
-				interrupt();
-
-				uint32_t primask         = EnterCriticalSection();
-				InterruptQueue::Queue[i] = nullptr;
-				ExitCriticalSection(primask);
-			}
+			read = Rings[level].ReadIndex.load(std::memory_order_relaxed);
+			slot = &Rings[level].Slots[read % MaxDepth];
+
+			// A slot that is reserved but not yet published is picked up on the next call
+			if (slot->Ready.load(std::memory_order_acquire))
+				break;
 		}
 
-		InterruptsPending = 0;
+		if (level == PriorityCount)
+			break;
+
+		uint32_t budget = slot->Budget;
+		uint64_t start  = TimeSource != nullptr ? TimeSource->GetCount() : 0;
+
+		// Yield back to the caller rather than start work that would run past the deadline
+		if (static_cast<Priority>(level) != Priority::High && TimeSource != nullptr && start + budget >= deadline)
+			break;
+
+		// Move the callback out so the slot can be refilled while it runs
+		Callback callback(std::move(slot->Function));
+		slot->Ready.store(false, std::memory_order_relaxed);
+		Rings[level].ReadIndex.store(read + 1, std::memory_order_release);
+
+		if (callback)
+			callback();
+
+		if (budget != 0 && TimeSource != nullptr && TimeSource->GetCount() - start > budget)
+			OverrunCount.fetch_add(1, std::memory_order_relaxed);
 	}
 }
@@ -0,0 +1,51 @@
+#include "memory_regions.h"
+
+// Region bounds defined by the linker script
+extern uint8_t _sram_d1[], _eram_d1[];
+extern uint8_t _sram_d2[], _eram_d2[];
+extern uint8_t _sram_d3[], _eram_d3[];
+
+static void ConfigureNonCacheableRegion(uint8_t number, uint32_t base, uint8_t size)
+{
+	MPU_Region_InitTypeDef region = { 0 };
+
+	region.Enable           = MPU_REGION_ENABLE;
+	region.Number           = number;
+	region.BaseAddress      = base;
+	region.Size             = size;
+	region.SubRegionDisable = 0x00;
+	region.TypeExtField     = MPU_TEX_LEVEL1; // Normal memory, non-cacheable
+	region.AccessPermission = MPU_REGION_FULL_ACCESS;
+	region.DisableExec      = MPU_INSTRUCTION_ACCESS_DISABLE;
+	region.IsShareable      = MPU_ACCESS_NOT_SHAREABLE;
+	region.IsCacheable      = MPU_ACCESS_NOT_CACHEABLE;
+	region.IsBufferable     = MPU_ACCESS_NOT_BUFFERABLE;
+
+	HAL_MPU_ConfigRegion(&region);
+}
+
+void MemoryRegionsConfigureMpu(void)
+{
+	HAL_MPU_Disable();
+
+	ConfigureNonCacheableRegion(MPU_REGION_NUMBER0, D2_AHBSRAM_BASE, MPU_REGION_SIZE_32KB);
+	ConfigureNonCacheableRegion(MPU_REGION_NUMBER1, D3_SRAM_BASE, MPU_REGION_SIZE_16KB);
+
+	// Everything else keeps the default memory map
+	HAL_MPU_Enable(MPU_PRIVILEGED_DEFAULT);
+}
+
+static int IsInRegion(uintptr_t start, uintptr_t end, const uint8_t* regionStart, const uint8_t* regionEnd)
+{
+	return start >= (uintptr_t)regionStart && end <= (uintptr_t)regionEnd;
+}
+
+int MemoryRegionsIsDmaReachable(const void* address, uint32_t size)
+{
+	uintptr_t start = (uintptr_t)address;
+	uintptr_t end   = start + size;
+
+	return IsInRegion(start, end, _sram_d1, _eram_d1) ||
+	       IsInRegion(start, end, _sram_d2, _eram_d2) ||
+	       IsInRegion(start, end, _sram_d3, _eram_d3);
+}
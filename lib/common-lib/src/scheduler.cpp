@@ -8,8 +8,11 @@
  *
  */
 #include "scheduler.hpp"
+#include "critical_section.h"
 #include "errors.hpp"
 
+#include <algorithm>
+
 using namespace LumiVoxel;
 
 bool Scheduler::Init()
@@ -29,14 +32,20 @@ bool Scheduler::Init()
 		ErrorMessage::SetMessage("Scheduler: Required timer precision is too high\n");
 		return false;
 	}
+
+	// ARR is not preloaded so the period in progress can be shortened when a task is added
+	elapsed       = 0;
+	currentPeriod = MaxPeriod;
+	tim->ARR      = MaxPeriod - 1;
 	tim->DIER |= TIM_DIER_UIE;
-	tim->CNT = -1;
-	tim->CR1 = TIM_CR1_CEN | TIM_CR1_ARPE;
+	tim->CNT = 0;
+	tim->CR1 = TIM_CR1_CEN;
 
 	tasks.fill(nullptr);
 	intervals.fill(0);
 	nextUpdates.fill(0);
 	enabledTasks.reset();
+	heapSize = 0;
 
 	isInitialized = true;
 
@@ -45,58 +54,211 @@ bool Scheduler::Init()
 
 void Scheduler::Update()
 {
-	if (!isInitialized || paused)
+	if (!isInitialized)
 		return;
 
-	if (++counter >= timerRollOver)
-		counter = 0;
+	elapsed += currentPeriod;
 
-	// Uses highest task index to avoid iterating through all tasks
-	for (size_t i = 0; i < highestTaskIndex; i++)
+	// Bounded so a queue that stays full cannot keep the interrupt busy
+	for (size_t n = 0; n < MaxTasks && heapSize > 0 && !paused; n++)
 	{
+		uint8_t i = heap[0];
+		if (nextUpdates[i] > elapsed)
+			break;
+
+		HeapRemove(0);
+
 		std::function<void()>& task = tasks[i];
-		if (task == nullptr || !enabledTasks[i])
+
+		// One-shot tasks are moved into the queue, periodic tasks are looked up by slot so queuing never copies them.
+		// The slot may be removed or reused before the queued run, the generation check skips it in that case.
+		bool queued;
+		if (intervals[i] == 0)
+		{
+			queued = InterruptQueue::AddInterrupt(std::move(task), priorities[i], budgets[i]);
+		}
+		else
+		{
+			uint32_t generation = generations[i];
+			auto run            = [this, i, generation] {
+				if (generations[i] == generation && tasks[i] != nullptr)
+					tasks[i]();
+			};
+
+			queued = InterruptQueue::AddInterrupt(run, priorities[i], budgets[i]);
+		}
+
+		// If the interrupt queue is full, try again next tick
+		if (!queued)
+		{
+			nextUpdates[i] = elapsed + timerPrecision;
+			HeapPush(i);
 			continue;
+		}
 
-		int32_t diff = counter - nextUpdates[i];
+		if (intervals[i] == 0)
+		{
+			generations[i]++;
+			task            = nullptr;
+			intervals[i]    = 0;
+			nextUpdates[i]  = 0;
+			enabledTasks[i] = false;
+		}
+		else
+		{
+			// Re-arm from the previous deadline to avoid drift, skipping any runs that were missed
+			nextUpdates[i] += intervals[i];
+			if (nextUpdates[i] <= elapsed)
+				nextUpdates[i] += ((elapsed - nextUpdates[i]) / intervals[i] + 1) * intervals[i];
+
+			HeapPush(i);
+		}
+	}
 
-		if (diff >= 0 && diff < (timerPrecision / 2))
+	ScheduleUpdate();
+}
+
+uint64_t Scheduler::GetNow() const
+{
+	uint64_t now = elapsed + tim->CNT;
+
+	// The counter wrapped but the interrupt has not been handled yet, read it again after the wrap
+	if ((tim->SR & TIM_SR_UIF) != 0)
+		now = elapsed + currentPeriod + tim->CNT;
+
+	return now;
+}
+
+void Scheduler::ScheduleUpdate()
+{
+	if (!isInitialized)
+		return;
+
+	uint32_t primask = EnterCriticalSection();
+
+	// A pending update is handled by the interrupt, which schedules the next one itself
+	if ((tim->SR & TIM_SR_UIF) == 0)
+	{
+		uint32_t period = MaxPeriod;
+
+		if (heapSize > 0 && !paused)
 		{
-			// If the interrupt queue is full, try again next time
-			if (!InterruptQueue::AddInterrupt(task))
-				continue;
-			
-			if (intervals[i] == 0)
-			{
-				task            = nullptr;
-				intervals[i]    = 0;
-				nextUpdates[i]  = 0;
-				enabledTasks[i] = false;
-			}
-			else
-			{
-				nextUpdates[i] = GetNextUpdate(counter, timerRollOver, intervals[i]);
-			}
+			uint64_t next     = nextUpdates[heap[0]];
+			uint32_t earliest = std::min<uint32_t>(tim->CNT + MinimumLead, MaxPeriod);
+			uint64_t due      = next > elapsed ? next - elapsed : 0;
+			period            = static_cast<uint32_t>(std::clamp<uint64_t>(due, earliest, MaxPeriod));
 		}
+
+		tim->ARR      = period - 1;
+		currentPeriod = period;
+	}
+
+	ExitCriticalSection(primask);
+}
+
+void Scheduler::HeapSiftUp(size_t position)
+{
+	while (position > 0)
+	{
+		size_t parent = (position - 1) / 2;
+		if (nextUpdates[heap[parent]] <= nextUpdates[heap[position]])
+			break;
+
+		std::swap(heap[parent], heap[position]);
+		position = parent;
+	}
+}
+
+void Scheduler::HeapSiftDown(size_t position)
+{
+	while (true)
+	{
+		size_t smallest = position;
+		size_t left     = 2 * position + 1;
+		size_t right    = left + 1;
+
+		if (left < heapSize && nextUpdates[heap[left]] < nextUpdates[heap[smallest]])
+			smallest = left;
+		if (right < heapSize && nextUpdates[heap[right]] < nextUpdates[heap[smallest]])
+			smallest = right;
+
+		if (smallest == position)
+			break;
+
+		std::swap(heap[smallest], heap[position]);
+		position = smallest;
+	}
+}
+
+void Scheduler::HeapPush(uint8_t index)
+{
+	heap[heapSize] = index;
+	HeapSiftUp(heapSize++);
+}
+
+void Scheduler::HeapRemove(size_t position)
+{
+	heap[position] = heap[--heapSize];
+	if (position < heapSize)
+	{
+		HeapSiftDown(position);
+		HeapSiftUp(position);
 	}
 }
 
-size_t Scheduler::AddTask(const std::function<void()>& task, uint32_t interval, uint32_t startOffset, bool enabled)
+void Scheduler::Arm(size_t index)
 {
-	if (startOffset >= timerRollOver || interval >= timerRollOver)
-		return std::numeric_limits<size_t>::max();
+	if (tasks[index] == nullptr || !enabledTasks[index])
+		return;
+
+	for (size_t i = 0; i < heapSize; i++)
+	{
+		if (heap[i] == index)
+			return;
+	}
+
+	nextUpdates[index] = GetFirstUpdate(GetNow(), intervals[index], startOffsets[index]);
+	HeapPush(static_cast<uint8_t>(index));
+}
 
+void Scheduler::Disarm(size_t index)
+{
+	for (size_t i = 0; i < heapSize; i++)
+	{
+		if (heap[i] == index)
+		{
+			HeapRemove(i);
+			return;
+		}
+	}
+}
+
+size_t Scheduler::AddTaskCounts(
+	const std::function<void()>& task,
+	uint32_t interval,
+	uint32_t startOffset,
+	bool enabled,
+	InterruptQueue::Priority priority,
+	uint32_t budget)
+{
 	for (size_t i = 0; i < MaxTasks; i++)
 	{
 		if (tasks[i] == nullptr)
 		{
+			uint32_t primask = EnterCriticalSection();
+
+			generations[i]++;
 			tasks[i]        = task;
 			intervals[i]    = interval;
-			nextUpdates[i]  = GetFirstUpdate(counter, interval, startOffset);
+			startOffsets[i] = startOffset;
+			priorities[i]   = priority;
+			budgets[i]      = budget;
 			enabledTasks[i] = enabled;
+			Arm(i);
 
-			if (i >= highestTaskIndex)
-				highestTaskIndex = i + 1; // Update highest task index to the empty slot above
+			ExitCriticalSection(primask);
+
+			ScheduleUpdate();
 
 			return i;
 		}
@@ -110,22 +272,48 @@ bool Scheduler::RemoveTask(size_t index)
 	if (index >= MaxTasks)
 		return false;
 
+	uint32_t primask = EnterCriticalSection();
+
+	Disarm(index);
+	generations[index]++;
 	tasks[index]        = nullptr;
 	intervals[index]    = 0;
 	nextUpdates[index]  = 0;
 	enabledTasks[index] = false;
 
-	if (index == highestTaskIndex - 1)
-	{
-		for (size_t i = highestTaskIndex - 1; i > 0; i--)
-		{
-			if (tasks[i] != nullptr)
-			{
-				highestTaskIndex = i + 1;
-				break;
-			}
-		}
-	}
+	ExitCriticalSection(primask);
+
+	ScheduleUpdate();
 
 	return true;
-}
\ No newline at end of file
+}
+
+void Scheduler::EnableTask(size_t index)
+{
+	if (index >= MaxTasks)
+		return;
+
+	uint32_t primask = EnterCriticalSection();
+
+	enabledTasks[index] = true;
+	Arm(index);
+
+	ExitCriticalSection(primask);
+
+	ScheduleUpdate();
+}
+
+void Scheduler::DisableTask(size_t index)
+{
+	if (index >= MaxTasks)
+		return;
+
+	uint32_t primask = EnterCriticalSection();
+
+	enabledTasks[index] = false;
+	Disarm(index);
+
+	ExitCriticalSection(primask);
+
+	ScheduleUpdate();
+}
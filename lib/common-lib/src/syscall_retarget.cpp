@@ -2,7 +2,11 @@
 #include STM32_INCLUDE(STM32_PROCESSOR, hal.h)
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_def.h)
 #include STM32_INCLUDE(STM32_PROCESSOR, hal_uart.h)
+#include "memory_regions.h"
 #include "syscall_retarget.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
 #include <errno.h>
 #include <functional>
 #include <stdio.h>
@@ -13,6 +17,142 @@ uint32_t stdoutTimeout = 0;
 std::function<void()> writeOnTxStart;
 std::function<void()> writeOnTxEnd;
 
+/// @brief Size of the stdout ring buffer, a power of two
+static constexpr uint32_t StdoutBufferSize = 4096;
+static_assert((StdoutBufferSize & (StdoutBufferSize - 1)) == 0, "StdoutBufferSize must be a power of two");
+
+/// @brief Largest part of a write reserved at once, so a blocking write can make progress while the DMA drains
+static constexpr uint32_t MaxReservation = StdoutBufferSize / 2;
+
+// DMA cannot reach DTCM, D2 SRAM is not cached so the buffer needs no cache maintenance
+static uint8_t stdoutBuffer[StdoutBufferSize] DMA_BUFFER_D2;
+
+static std::atomic<uint32_t> stdoutHead      = 0; ///< @brief Free running index of the next byte to reserve
+static std::atomic<uint32_t> stdoutTail      = 0; ///< @brief Free running index of the next byte to transmit
+static std::atomic<uint32_t> writersInFlight = 0; ///< @brief Number of writes between reserving and filling their space
+static std::atomic<bool> transmitting        = false;
+static uint32_t transmitLength               = 0;
+
+static bool bufferedOutput                  = false;
+static std::atomic<uint32_t> droppedBytes   = 0;
+static SyscallOverflowPolicy overflowPolicy = SyscallOverflowPolicy::Drop;
+
+static bool IsBuffered()
+{
+	return bufferedOutput;
+}
+
+static bool CannotWait()
+{
+	return (SCB->ICSR & SCB_ICSR_VECTACTIVE_Msk) != 0 || __get_PRIMASK() != 0;
+}
+
+/**
+ * @brief Start a DMA transfer of the next contiguous part of the buffer if none is running
+ * @remark Only reads the buffer while no write is filling its space, the last write to finish starts the transfer instead
+ */
+static void StartTransmit()
+{
+	while (writersInFlight.load(std::memory_order_acquire) == 0 && !transmitting.exchange(true, std::memory_order_acquire))
+	{
+		uint32_t tail = stdoutTail.load(std::memory_order_relaxed);
+		uint32_t head = stdoutHead.load(std::memory_order_acquire);
+
+		if (head != tail)
+		{
+			uint32_t offset = tail % StdoutBufferSize;
+			transmitLength  = std::min(head - tail, StdoutBufferSize - offset);
+
+			if (writeOnTxStart)
+				writeOnTxStart();
+
+			if (HAL_UART_Transmit_DMA(stdoutUart, &stdoutBuffer[offset], transmitLength) != HAL_OK)
+				transmitting.store(false, std::memory_order_release); // Retried on the next write
+
+			return;
+		}
+
+		transmitting.store(false, std::memory_order_release);
+
+		// A write that finished while the flag was held left its data for this call to send
+		if (stdoutHead.load(std::memory_order_acquire) == head)
+			return;
+	}
+}
+
+static void TransmitComplete(UART_HandleTypeDef*)
+{
+	stdoutTail.fetch_add(transmitLength, std::memory_order_release);
+
+	if (writeOnTxEnd)
+		writeOnTxEnd();
+
+	transmitting.store(false, std::memory_order_release);
+	StartTransmit();
+}
+
+static void TransmitError(UART_HandleTypeDef* huart)
+{
+	// Receive errors are reported here as well, only a transmit that was aborted is done with the buffer
+	if (transmitting.load(std::memory_order_relaxed) && huart->gState == HAL_UART_STATE_READY)
+		TransmitComplete(huart);
+}
+
+static bool TryReserve(uint32_t length, uint32_t& start)
+{
+	uint32_t head = stdoutHead.load(std::memory_order_relaxed);
+	do
+	{
+		if (head + length - stdoutTail.load(std::memory_order_acquire) > StdoutBufferSize)
+			return false;
+	} while (!stdoutHead.compare_exchange_weak(head, head + length, std::memory_order_acq_rel, std::memory_order_relaxed));
+
+	start = head;
+	return true;
+}
+
+static int WriteBuffered(const char* ptr, int len)
+{
+	uint32_t written = 0;
+	uint32_t length  = static_cast<uint32_t>(len);
+
+	while (written < length)
+	{
+		uint32_t chunk = std::min(length - written, MaxReservation);
+		uint32_t start = 0;
+
+		writersInFlight.fetch_add(1, std::memory_order_acq_rel);
+
+		bool reserved = TryReserve(chunk, start);
+		if (reserved)
+		{
+			uint32_t offset = start % StdoutBufferSize;
+			uint32_t first  = std::min(chunk, StdoutBufferSize - offset);
+			memcpy(&stdoutBuffer[offset], ptr + written, first);
+			memcpy(&stdoutBuffer[0], ptr + written + first, chunk - first);
+		}
+
+		writersInFlight.fetch_sub(1, std::memory_order_acq_rel);
+		StartTransmit();
+
+		if (reserved)
+		{
+			written += chunk;
+			continue;
+		}
+
+		// Waiting relies on the transfer complete interrupt, which cannot run from an interrupt or with interrupts masked
+		if (overflowPolicy == SyscallOverflowPolicy::Drop || CannotWait())
+		{
+			droppedBytes.fetch_add(length - written, std::memory_order_relaxed);
+			break;
+		}
+	}
+
+	// Dropped output is reported as written so the C library does not retry it
+	return len;
+}
+
 void SyscallUARTRetarget(UART_HandleTypeDef* huart, uint32_t timeout, std::function<void()> onTxStart, std::function<void()> onTxEnd)
 {
 	stdoutUart    = huart;
@@ -20,6 +160,21 @@ void SyscallUARTRetarget(UART_HandleTypeDef* huart, uint32_t timeout, std::funct
 
 	writeOnTxStart = onTxStart;
 	writeOnTxEnd   = onTxEnd;
+
+	// Without a TX DMA stream or completion callbacks the buffer could never drain, so transmit directly instead
+	bufferedOutput = false;
+#if (USE_HAL_UART_REGISTER_CALLBACKS == 1)
+	if (huart != nullptr && huart->hdmatx != nullptr)
+	{
+		bufferedOutput = HAL_UART_RegisterCallback(huart, HAL_UART_TX_COMPLETE_CB_ID, TransmitComplete) == HAL_OK &&
+		                 HAL_UART_RegisterCallback(huart, HAL_UART_ERROR_CB_ID, TransmitError) == HAL_OK;
+	}
+#endif
+}
+
+void SyscallSetOverflowPolicy(SyscallOverflowPolicy policy)
+{
+	overflowPolicy = policy;
 }
 
 extern "C"
@@ -29,17 +184,50 @@ extern "C"
 		return stdoutUart != nullptr;
 	}
 
-	int _write(int file, char* ptr, int len)
+	void SyscallFlush()
 	{
-		if (writeOnTxStart)
-			writeOnTxStart();
+		if (!IsBuffered())
+			return;
+
+		while (true)
+		{
+			if (!transmitting.load(std::memory_order_acquire))
+			{
+				StartTransmit();
+
+				// Nothing left, or a write interrupted by the caller still holds its space
+				if (!transmitting.load(std::memory_order_acquire))
+					break;
+			}
+
+			// Interrupts may be masked after a fatal error, so drive the transfer from here
+			if (CannotWait())
+			{
+				HAL_DMA_IRQHandler(stdoutUart->hdmatx);
+				HAL_UART_IRQHandler(stdoutUart);
+			}
+		}
+	}
 
+	uint32_t SyscallGetDroppedBytes()
+	{
+		return droppedBytes.load(std::memory_order_relaxed);
+	}
+
+	int _write(int file, char* ptr, int len)
+	{
 		if (!(file == STDOUT_FILENO || file == STDERR_FILENO))
 		{
 			errno = EBADF;
 			return -1;
 		}
 
+		if (IsBuffered())
+			return WriteBuffered(ptr, len);
+
+		if (writeOnTxStart)
+			writeOnTxStart();
+
 		HAL_StatusTypeDef status = HAL_UART_Transmit(stdoutUart, (uint8_t*)ptr, len, stdoutTimeout);
 
 		if (writeOnTxEnd)
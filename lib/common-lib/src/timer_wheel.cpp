@@ -0,0 +1,241 @@
+#include "timer_wheel.hpp"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+using namespace LumiVoxel;
+
+void TimerWheel::Clear(uint64_t time)
+{
+	for (Timer& timer : timers)
+	{
+		timer.Callback = nullptr;
+		timer.Level    = FreeLevel;
+		timer.Next     = InvalidIndex;
+		timer.Prev     = InvalidIndex;
+		timer.Generation++;
+	}
+
+	for (auto& level : slots)
+		level.fill(InvalidIndex);
+
+	occupied.fill(0);
+	overflow  = InvalidIndex;
+	wheelTime = time;
+}
+
+void TimerWheel::Link(uint8_t index)
+{
+	Timer& timer = timers[index];
+
+	// Timers that are already due go in the current slot
+	uint64_t place = std::max(timer.Expiry, wheelTime);
+	uint64_t diff  = place ^ wheelTime;
+
+	if ((diff >> WheelBits) != 0)
+	{
+		timer.Level = OverflowLevel;
+		timer.Slot  = 0;
+	}
+	else
+	{
+		timer.Level = diff == 0 ? 0 : (std::bit_width(diff) - 1) / LevelBits;
+		timer.Slot  = (place >> (timer.Level * LevelBits)) & (SlotCount - 1);
+		occupied[timer.Level] |= 1ull << timer.Slot;
+	}
+
+	uint8_t& head = GetHead(timer.Level, timer.Slot);
+	timer.Prev    = InvalidIndex;
+	timer.Next    = head;
+	if (head != InvalidIndex)
+		timers[head].Prev = index;
+	head = index;
+}
+
+void TimerWheel::Unlink(uint8_t index)
+{
+	Timer& timer = timers[index];
+
+	if (timer.Prev != InvalidIndex)
+		timers[timer.Prev].Next = timer.Next;
+	else
+		GetHead(timer.Level, timer.Slot) = timer.Next;
+
+	if (timer.Next != InvalidIndex)
+		timers[timer.Next].Prev = timer.Prev;
+
+	if (timer.Level < LevelCount && slots[timer.Level][timer.Slot] == InvalidIndex)
+		occupied[timer.Level] &= ~(1ull << timer.Slot);
+
+	timer.Next = InvalidIndex;
+	timer.Prev = InvalidIndex;
+}
+
+TimerWheel::Handle TimerWheel::Add(
+	uint64_t expiry,
+	const std::function<void()>& callback,
+	uint32_t period,
+	InterruptQueue::Priority priority,
+	uint32_t budget)
+{
+	if (callback == nullptr)
+		return Handle();
+
+	for (size_t i = 0; i < MaxTimers; i++)
+	{
+		uint8_t index = (nextAllocation + i) % MaxTimers;
+		Timer& timer  = timers[index];
+		if (timer.Level != FreeLevel)
+			continue;
+
+		timer.Expiry   = expiry;
+		timer.Period   = period;
+		timer.Callback = callback;
+		timer.Priority = priority;
+		timer.Budget   = budget;
+		Link(index);
+
+		nextAllocation = (index + 1) % MaxTimers;
+
+		return Handle { index, timer.Generation };
+	}
+
+	// No free timers
+	return Handle();
+}
+
+bool TimerWheel::Cancel(Handle& handle)
+{
+	if (!handle.IsValid() || handle.Index >= MaxTimers)
+		return false;
+
+	Timer& timer = timers[handle.Index];
+	bool pending = timer.Generation == handle.Generation && timer.Level != FreeLevel;
+	if (pending)
+	{
+		// The callback is left in place, it may be the one currently running
+		Unlink(handle.Index);
+		timer.Level = FreeLevel;
+		timer.Generation++;
+	}
+
+	handle = Handle();
+	return pending;
+}
+
+void TimerWheel::Expire(uint8_t index, uint64_t now)
+{
+	Timer& timer = timers[index];
+
+	if (timer.Period == 0)
+	{
+		// One-shot callbacks are moved into the queue, if it is full try again shortly
+		if (InterruptQueue::AddInterrupt(std::move(timer.Callback), timer.Priority, timer.Budget))
+		{
+			timer.Level = FreeLevel;
+			timer.Generation++;
+		}
+		else
+		{
+			timer.Expiry = now + RetryDelay;
+			Link(index);
+		}
+
+		return;
+	}
+
+	// Periodic callbacks are referenced, so a timer cancelled before the callback runs is skipped
+	uint16_t generation = timer.Generation;
+	InterruptQueue::AddInterrupt([this, index, generation] {
+		Timer& timer = timers[index];
+		if (timer.Generation == generation && timer.Level != FreeLevel)
+			timer.Callback();
+	},
+		timer.Priority, timer.Budget);
+
+	// Re-arm from the previous expiry to avoid drift, skipping any periods that were missed
+	timer.Expiry += timer.Period;
+	if (timer.Expiry <= now)
+		timer.Expiry += ((now - timer.Expiry) / timer.Period + 1) * timer.Period;
+
+	Link(index);
+}
+
+void TimerWheel::Advance(uint64_t now)
+{
+	for (size_t step = 0; step < MaxStepsPerAdvance; step++)
+	{
+		// Redistribute the slots the wheel time has reached, highest level first so timers can drop several levels
+		for (size_t level = LevelCount - 1; level > 0; level--)
+		{
+			uint8_t slot  = (wheelTime >> (level * LevelBits)) & (SlotCount - 1);
+			uint8_t index = slots[level][slot];
+			if (index == InvalidIndex)
+				continue;
+
+			slots[level][slot] = InvalidIndex;
+			occupied[level] &= ~(1ull << slot);
+			while (index != InvalidIndex)
+			{
+				uint8_t next = timers[index].Next;
+				Link(index);
+				index = next;
+			}
+		}
+
+		// Timers beyond the top level are filed once the wheel enters their top level block
+		if (overflow != InvalidIndex && (wheelTime & ((1ull << WheelBits) - 1)) == 0)
+		{
+			uint8_t index = overflow;
+			overflow      = InvalidIndex;
+			while (index != InvalidIndex)
+			{
+				uint8_t next = timers[index].Next;
+				Link(index);
+				index = next;
+			}
+		}
+
+		// Everything in the current level 0 slot is due
+		uint8_t slot  = wheelTime & (SlotCount - 1);
+		uint8_t index = slots[0][slot];
+		slots[0][slot] = InvalidIndex;
+		occupied[0] &= ~(1ull << slot);
+		while (index != InvalidIndex)
+		{
+			uint8_t next = timers[index].Next;
+			Expire(index, now);
+			index = next;
+		}
+
+		if (wheelTime >= now)
+			return;
+
+		wheelTime = std::min(GetNextExpiry(), now);
+	}
+}
+
+uint64_t TimerWheel::GetNextExpiry() const
+{
+	if ((occupied[0] & (1ull << (wheelTime & (SlotCount - 1)))) != 0)
+		return wheelTime;
+
+	// Lower levels always expire before higher ones, so the first occupied slot found is the next one
+	for (size_t level = 0; level < LevelCount; level++)
+	{
+		size_t shift    = level * LevelBits;
+		size_t current  = (wheelTime >> shift) & (SlotCount - 1);
+		uint64_t above  = current == SlotCount - 1 ? 0 : occupied[level] & (~0ull << (current + 1));
+		if (above == 0)
+			continue;
+
+		uint64_t blockMask = (1ull << (shift + LevelBits)) - 1;
+		return (wheelTime & ~blockMask) | (static_cast<uint64_t>(std::countr_zero(above)) << shift);
+	}
+
+	if (overflow != InvalidIndex)
+		return ((wheelTime >> WheelBits) + 1) << WheelBits;
+
+	return NoExpiry;
+}
@@ -0,0 +1,37 @@
+/**
+ * @file stm32hostxx_hal.h
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Host stand-in for the HAL, only the registers the common lib touches outside of peripherals
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+#pragma once
+
+#include <cstdint>
+
+struct SCB_Type
+{
+	volatile uint32_t ICSR; ///< @brief Always reads as thread mode
+};
+
+inline SCB_Type HostScb = {};
+
+#define SCB                     (&HostScb)
+#define SCB_ICSR_VECTACTIVE_Msk 0x1FFUL
+
+struct TIM_TypeDef
+{
+	volatile uint32_t SR;
+	volatile uint32_t CNT;
+};
+
+#define TIM_SR_UIF 0x1UL
+
+/// @brief Interrupts are never taken on the host, so the PRIMASK stand-ins only keep its value
+inline uint32_t HostPrimask = 0;
+
+inline uint32_t __get_PRIMASK() { return HostPrimask; }
+inline void __set_PRIMASK(uint32_t primask) { HostPrimask = primask; }
+inline void __disable_irq() { HostPrimask = 1; }
@@ -0,0 +1,151 @@
+/**
+ * @file interrupt_queue_stress.cpp
+ * @author Purdue Solar Racing (Aidan Orr)
+ * @brief Host stress test of the InterruptQueue rings with several producer threads and one consumer
+ * @version 0.1
+ *
+ * @copyright Copyright (c) 2025
+ *
+ */
+
+#include "interrupt_queue.hpp"
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstdio>
+#include <thread>
+#include <vector>
+
+using namespace LumiVoxel;
+
+static constexpr size_t ProducerCount      = 4;
+static constexpr uint32_t ItemsPerProducer = 50000;
+
+/// @brief Number of times each item ran, indexed by producer then sequence number
+static std::vector<std::atomic<uint8_t>> runCounts(ProducerCount * ItemsPerProducer);
+/// @brief Sequence number each producer last ran per priority, to check the order within a ring
+static std::array<std::array<int64_t, InterruptQueue::PriorityCount>, ProducerCount> lastRun;
+
+static std::atomic<uint32_t> orderErrors = 0;
+
+int main()
+{
+	for (auto& levels : lastRun)
+		levels.fill(-1);
+
+	std::array<std::atomic<uint32_t>, ProducerCount> queued  = {};
+	std::array<std::atomic<uint32_t>, ProducerCount> dropped = {};
+	std::atomic<size_t> producersDone                        = 0;
+
+	std::vector<std::thread> producers;
+	for (size_t producer = 0; producer < ProducerCount; producer++)
+	{
+		producers.emplace_back([producer, &queued, &dropped, &producersDone] {
+			for (uint32_t sequence = 0; sequence < ItemsPerProducer; sequence++)
+			{
+				auto priority = static_cast<InterruptQueue::Priority>(sequence % InterruptQueue::PriorityCount);
+				size_t level  = static_cast<size_t>(priority);
+
+				// Captures past the inline storage size would fail to compile, so this also checks it never allocates
+				auto callback = [producer, sequence, level] {
+					runCounts[producer * ItemsPerProducer + sequence].fetch_add(1, std::memory_order_relaxed);
+
+					int64_t& last = lastRun[producer][level];
+					if (static_cast<int64_t>(sequence) <= last)
+						orderErrors.fetch_add(1, std::memory_order_relaxed);
+					last = sequence;
+				};
+
+				// A full ring rejects the callback without consuming it, so it is retried until the consumer caught up
+				while (!InterruptQueue::AddInterrupt(callback, priority))
+				{
+					dropped[producer].fetch_add(1, std::memory_order_relaxed);
+					std::this_thread::yield();
+				}
+
+				queued[producer].fetch_add(1, std::memory_order_relaxed);
+			}
+
+			producersDone.fetch_add(1, std::memory_order_release);
+		});
+	}
+
+	// The consumer drains until every producer finished and nothing is left pending
+	while (true)
+	{
+		bool done = producersDone.load(std::memory_order_acquire) == ProducerCount;
+
+		InterruptQueue::HandleQueue();
+
+		size_t pending = 0;
+		for (size_t level = 0; level < InterruptQueue::PriorityCount; level++)
+			pending += InterruptQueue::GetPending(static_cast<InterruptQueue::Priority>(level));
+
+		if (done && pending == 0)
+			break;
+	}
+
+	for (std::thread& thread : producers)
+		thread.join();
+
+	uint64_t totalQueued  = 0;
+	uint64_t totalDropped = 0;
+	for (size_t producer = 0; producer < ProducerCount; producer++)
+	{
+		totalQueued += queued[producer];
+		totalDropped += dropped[producer];
+	}
+
+	uint64_t ran        = 0;
+	uint64_t duplicated = 0;
+	for (std::atomic<uint8_t>& count : runCounts)
+	{
+		uint8_t value = count.load(std::memory_order_relaxed);
+		ran += value != 0;
+		duplicated += value > 1;
+	}
+
+	uint64_t ringDrops = 0;
+	uint32_t highWater = 0;
+	for (size_t level = 0; level < InterruptQueue::PriorityCount; level++)
+	{
+		ringDrops += InterruptQueue::GetDropCount(static_cast<InterruptQueue::Priority>(level));
+		highWater = std::max(highWater, InterruptQueue::GetHighWater(static_cast<InterruptQueue::Priority>(level)));
+	}
+
+	std::printf("queued %llu, dropped %llu, ran %llu, duplicated %llu, out of order %u, high water %u\n",
+	            static_cast<unsigned long long>(totalQueued),
+	            static_cast<unsigned long long>(totalDropped),
+	            static_cast<unsigned long long>(ran),
+	            static_cast<unsigned long long>(duplicated),
+	            orderErrors.load(),
+	            highWater);
+
+	bool passed = true;
+	if (totalQueued != ProducerCount * ItemsPerProducer || ran != totalQueued)
+	{
+		std::printf("FAIL: %llu callbacks were lost\n", static_cast<unsigned long long>(ProducerCount * ItemsPerProducer - ran));
+		passed = false;
+	}
+
+	if (duplicated != 0)
+	{
+		std::printf("FAIL: callbacks ran more than once\n");
+		passed = false;
+	}
+
+	if (orderErrors != 0)
+	{
+		std::printf("FAIL: callbacks of a producer ran out of order\n");
+		passed = false;
+	}
+
+	if (ringDrops != totalDropped)
+	{
+		std::printf("FAIL: drop counters report %llu drops\n", static_cast<unsigned long long>(ringDrops));
+		passed = false;
+	}
+
+	return passed ? 0 : 1;
+}
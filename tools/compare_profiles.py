@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+"""
+Compare the cycles per frame of two firmware builds, one with the hot functions in flash and one with them in ITCM.
+
+Each log is the decoded UART output of a build, see `tools/log_decoder.py`. The firmware prints a cycle profile every
+10 seconds, the profiles of each log are averaged. Build the flash placement with `-DITCM_HOT_CODE=OFF`.
+
+Usage:
+    python3 tools/compare_profiles.py flash.log itcm.log
+"""
+
+import argparse
+import re
+import sys
+
+PROFILE = re.compile(
+    r"Cycles per frame with hot code in (\w+): map (\d+), write (\d+), vsync (\d+), total (\d+)"
+)
+STAGES = ("map", "write", "vsync", "total")
+
+
+def read_profile(path):
+    placement = None
+    samples = []
+
+    with open(path, encoding="utf-8", errors="replace") as file:
+        for line in file:
+            match = PROFILE.search(line)
+            if match is None:
+                continue
+
+            placement = match.group(1)
+            values = [int(value) for value in match.groups()[1:]]
+
+            # The first window starts before the render loop, so it has no frames
+            if values[-1] > 0:
+                samples.append(values)
+
+    if not samples:
+        raise ValueError(f"{path} has no cycle profiles")
+
+    averages = [sum(column) / len(samples) for column in zip(*samples)]
+    return placement, len(samples), dict(zip(STAGES, averages))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("baseline", help="Decoded log of the baseline build, usually flash placement")
+    parser.add_argument("candidate", help="Decoded log of the candidate build, usually ITCM placement")
+    args = parser.parse_args()
+
+    try:
+        baseline = read_profile(args.baseline)
+        candidate = read_profile(args.candidate)
+    except ValueError as error:
+        sys.exit(str(error))
+
+    print(f"{'Stage':<8}{baseline[0] + ' cycles':>16}{candidate[0] + ' cycles':>16}{'Change':>10}")
+    for stage in STAGES:
+        before = baseline[2][stage]
+        after = candidate[2][stage]
+        change = f"{(after - before) / before * 100:+.1f}%" if before > 0 else "-"
+        print(f"{stage:<8}{before:>16.0f}{after:>16.0f}{change:>10}")
+
+    print(f"\n{baseline[1]} and {candidate[1]} profile windows averaged")
+
+
+if __name__ == "__main__":
+    main()
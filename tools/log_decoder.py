@@ -0,0 +1,179 @@
+#!/usr/bin/env python3
+"""
+Decode binary log records from the firmware's UART output.
+
+Text output is passed through unchanged. Binary records written by LOG_BINARY are rebuilt from the format strings in the
+`.logstr` section of the firmware ELF file.
+
+Usage:
+    python3 tools/log_decoder.py build/lumi-voxel.elf < capture.bin
+    python3 tools/log_decoder.py build/lumi-voxel.elf --port /dev/ttyACM0 --baud 115200
+"""
+
+import argparse
+import re
+import struct
+import sys
+
+FRAME_MARKER = 0x00
+HEADER_SIZE = 6  # ID and timestamp, after the marker and length
+
+CONVERSION = re.compile(r"%([-+ #0]*(?:\d+|\*)?(?:\.(?:\d+|\*))?)(hh|h|ll|l|j|z|t|L)?([diouxXeEfgGcsp%])")
+
+
+class Elf:
+    """Minimal ELF reader, only the section headers and contents are needed."""
+
+    def __init__(self, path):
+        with open(path, "rb") as file:
+            self.data = file.read()
+
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError(f"{path} is not an ELF file")
+
+        is64 = self.data[4] == 2
+        endian = "<" if self.data[5] == 1 else ">"
+
+        if is64:
+            shoff, = struct.unpack_from(endian + "Q", self.data, 0x28)
+            shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", self.data, 0x3A)
+            header = endian + "IIQQQQIIQQ"
+        else:
+            shoff, = struct.unpack_from(endian + "I", self.data, 0x20)
+            shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", self.data, 0x2E)
+            header = endian + "IIIIIIIIII"
+
+        self.sections = []
+        for i in range(shnum):
+            name, kind, flags, addr, offset, size, *_ = struct.unpack_from(header, self.data, shoff + i * shentsize)
+            self.sections.append({"name": name, "type": kind, "flags": flags, "addr": addr, "offset": offset, "size": size})
+
+        names = self.sections[shstrndx]
+        for section in self.sections:
+            section["name"] = self.read_string(names["offset"] + section["name"])
+
+    def read_string(self, offset):
+        end = self.data.index(b"\0", offset)
+        return self.data[offset:end].decode("utf-8", errors="replace")
+
+    def section(self, name):
+        return next((s for s in self.sections if s["name"] == name), None)
+
+    def string_at_address(self, address):
+        """Read a string stored in a loaded section, used for %s arguments."""
+        for section in self.sections:
+            allocated = section["flags"] & 0x2
+            has_data = section["type"] != 8  # SHT_NOBITS
+            if allocated and has_data and section["addr"] <= address < section["addr"] + section["size"]:
+                return self.read_string(section["offset"] + address - section["addr"])
+        return f"<string at 0x{address:08X}>"
+
+
+class Decoder:
+    def __init__(self, elf):
+        self.elf = elf
+        self.logstr = elf.section(".logstr")
+        if self.logstr is None:
+            raise ValueError("The ELF file has no .logstr section")
+
+    def format_string(self, record_id):
+        # The ID is the low 16 bits of the string address, the section is at address 0 in the firmware
+        offset = (record_id - self.logstr["addr"]) & 0xFFFF
+        if offset >= self.logstr["size"]:
+            return None
+        return self.elf.read_string(self.logstr["offset"] + offset)
+
+    def format_record(self, record_id, arguments):
+        text = self.format_string(record_id)
+        if text is None:
+            return f"<unknown log ID 0x{record_id:04X}>"
+
+        values = []
+        position = 0
+
+        def convert(match):
+            nonlocal position
+            flags, length, kind = match.groups()
+            if kind == "%":
+                return "%%"
+
+            size = 8 if length in ("ll", "j") else 4
+            raw = arguments[position : position + size]
+            position += size
+            if len(raw) < size:
+                values.append(0)
+                return "<missing>"
+
+            if kind in "di":
+                values.append(int.from_bytes(raw, "little", signed=True))
+            elif kind in "ouxXc":
+                values.append(int.from_bytes(raw, "little"))
+            elif kind in "eEfgG":
+                values.append(struct.unpack("<f", raw)[0])
+            elif kind == "s":
+                values.append(self.elf.string_at_address(int.from_bytes(raw, "little")))
+            elif kind == "p":
+                values.append(int.from_bytes(raw, "little"))
+                return "0x%08X"
+
+            # Python has no length modifiers and no star widths from the arguments
+            return "%" + flags.replace("*", "") + kind
+
+        python_format = CONVERSION.sub(convert, text)
+        return (python_format % tuple(values)).rstrip("\n")
+
+    def decode(self, stream, output):
+        text = bytearray()
+        while True:
+            byte = stream.read(1)
+            if not byte:
+                break
+
+            if byte[0] != FRAME_MARKER:
+                text += byte
+                if byte == b"\n":
+                    output.write(text.decode("utf-8", errors="replace"))
+                    output.flush()
+                    text.clear()
+                continue
+
+            length = stream.read(1)
+            if not length:
+                break
+
+            record = stream.read(length[0])
+            if len(record) < HEADER_SIZE:
+                break
+
+            record_id, timestamp = struct.unpack_from("<HI", record)
+            if text:
+                output.write(text.decode("utf-8", errors="replace") + "\n")
+                text.clear()
+
+            output.write(f"[{timestamp / 1e6:12.6f}] {self.format_record(record_id, record[HEADER_SIZE:])}\n")
+            output.flush()
+
+        if text:
+            output.write(text.decode("utf-8", errors="replace"))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("elf", help="Firmware ELF file the log was produced by")
+    parser.add_argument("--port", help="Serial port to read from instead of stdin, requires pyserial")
+    parser.add_argument("--baud", type=int, default=115200, help="Serial port baud rate")
+    args = parser.parse_args()
+
+    decoder = Decoder(Elf(args.elf))
+
+    if args.port:
+        import serial
+
+        with serial.Serial(args.port, args.baud) as port:
+            decoder.decode(port, sys.stdout)
+    else:
+        decoder.decode(sys.stdin.buffer, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()